@@ -1,279 +1,2222 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-#include <mpi.h>
-#include <fstream>  
-#include <vector>   
-#include <iostream>
-#include <iomanip> 
-
-struct SimParamsMPI {
-    int n_global;         // Number of INNER grid points globally
-    int N_total_pts;      // Total grid points including boundaries (n_global + 2)
-    int max_iterations;   // Number of time steps
-    double c_const;       // Heat constant
-    double ds;            // Spatial step (delta_s)
-    double dt;            // Time step (delta_t)
-    double boundary_top;
-    double boundary_bottom;
-    double boundary_left;
-    double boundary_right;
-    int rank;             // MPI rank of the current process
-    int size;             // Total number of MPI processes
-    int my_num_rows;      // Number of actual rows this process handles
-    int my_start_row_global; // Global starting row index for this process
-    int ifirst_comp_local; // First local row index to compute
-    int ilast_comp_local;  // Last local row index to compute
-};
-
-// Helper to allocate 2D array
-double** allocate_2d_array(int rows, int cols) {
-    double* data = (double*)malloc(rows * cols * sizeof(double));
-    if (!data) return NULL;
-    double** array = (double**)malloc(rows * sizeof(double*));
-    if (!array) {
-        free(data);
-        return NULL;
-    }
-    for (int i = 0; i < rows; i++) {
-        array[i] = &(data[i * cols]);
-    }
-    return array;
-}
-
-void free_2d_array(double** array) {
-    if (array) {
-        if (array[0]) free(array[0]); // Free the contiguous block
-        free(array); // Free the row pointers
-    }
-}
-
-void parse_mpi_arguments(int argc, char* argv[], SimParamsMPI& params) {
-    if (argc > 1) params.n_global = atoi(argv[1]);
-    if (argc > 2) params.max_iterations = atoi(argv[2]);
-    if (argc > 3) params.boundary_top = atof(argv[3]);
-    if (argc > 4) params.boundary_bottom = atof(argv[4]);
-    if (argc > 5) params.boundary_left = atof(argv[5]);
-    if (argc > 6) params.boundary_right = atof(argv[6]);
-}
-
-void setup_mpi_simulation_parameters(SimParamsMPI& params) {
-    params.N_total_pts = params.n_global + 2;
-    params.ds = 1.0 / (params.n_global + 1);
-    params.dt = (params.ds * params.ds) / (4.0 * params.c_const);
-
-    //Domain Decomposition
-    int rows_per_proc = params.N_total_pts / params.size;
-    int remainder_rows = params.N_total_pts % params.size;
-    params.my_num_rows = rows_per_proc + (params.rank < remainder_rows ? 1 : 0);
-    params.my_start_row_global = params.rank * rows_per_proc + (params.rank < remainder_rows ? params.rank : remainder_rows);
-
-    //Determine computation range (ifirst, ilast) for local rows
-    params.ifirst_comp_local = 1;
-    params.ilast_comp_local = params.my_num_rows;
-
-    if (params.rank == 0) {
-        params.ifirst_comp_local = 2; 
-    }
-    if (params.rank == params.size - 1) {
-        params.ilast_comp_local = params.my_num_rows - 1;
-    }
-    
-    if (params.ifirst_comp_local > params.ilast_comp_local) {
-        params.ifirst_comp_local = 1; 
-        params.ilast_comp_local = 0;  
-    }
-
-    // if (params.rank == 0) {
-    //     printf("Running 2D Heat Equation (MPI Parallel)");
-    //     printf("Global Grid: %dx%d total points (%dx%d inner points)\n", params.N_total_pts, params.N_total_pts, params.n_global, params.n_global);
-    //     printf("Iterations: %d\n", params.max_iterations);
-    //     printf("c = %.2f, ds = %.4f, dt = %.6f\n", params.c_const, params.ds, params.dt);
-    //     printf("MPI Processes: %d\n", params.size);
-    //     printf("Boundaries: T=%.1f, B=%.1f, L=%.1f, R=%.1f\n", params.boundary_top, params.boundary_bottom, params.boundary_left, params.boundary_right);
-    // }
-}
-
-void initialize_local_grid(double** u_old_local, double** u_new_local, const SimParamsMPI& params) {
-    for (int i_local = 0; i_local < params.my_num_rows + 2; ++i_local) {
-        for (int j_col = 0; j_col < params.N_total_pts; ++j_col) {
-            u_old_local[i_local][j_col] = 0.0;
-            u_new_local[i_local][j_col] = 0.0;
-        }
-    }
-
-    for (int i_local_actual = 1; i_local_actual <= params.my_num_rows; ++i_local_actual) {
-        int i_global = params.my_start_row_global + i_local_actual - 1;
-        for (int j_col = 0; j_col < params.N_total_pts; ++j_col) {
-            if (i_global == 0) {
-                u_old_local[i_local_actual][j_col] = params.boundary_top;
-            } else if (i_global == params.N_total_pts - 1) {
-                u_old_local[i_local_actual][j_col] = params.boundary_bottom;
-            } else if (j_col == 0) {
-                u_old_local[i_local_actual][j_col] = params.boundary_left;
-            } else if (j_col == params.N_total_pts - 1) {
-                u_old_local[i_local_actual][j_col] = params.boundary_right;
-            } else {
-                u_old_local[i_local_actual][j_col] = 0.0; // f(x, y)
-            }
-            u_new_local[i_local_actual][j_col] = u_old_local[i_local_actual][j_col];
-        }
-    }
-}
-
-void perform_computation_step(double** u_old_local, double** u_new_local, const SimParamsMPI& params) {
-    for (int i_local = params.ifirst_comp_local; i_local <= params.ilast_comp_local; ++i_local) {
-        for (int j_col = 1; j_col < params.N_total_pts - 1; ++j_col) {
-            u_new_local[i_local][j_col] = u_old_local[i_local][j_col] +
-                params.c_const * params.dt / (params.ds * params.ds) *
-                (u_old_local[i_local + 1][j_col] + u_old_local[i_local - 1][j_col] +
-                 u_old_local[i_local][j_col + 1] + u_old_local[i_local][j_col - 1] -
-                 4.0 * u_old_local[i_local][j_col]);
-        }
-    }
-}
-
-void exchange_ghost_rows(double** u_new_local, const SimParamsMPI& params) {
-    MPI_Request reqs[4];
-    MPI_Status stats[4];
-    int req_count = 0;
-
-    if (params.rank > 0) {
-        MPI_Isend(u_new_local[1], params.N_total_pts, MPI_DOUBLE,
-                  params.rank - 1, 0, MPI_COMM_WORLD, &reqs[req_count++]);
-        MPI_Irecv(u_new_local[0], params.N_total_pts, MPI_DOUBLE,
-                  params.rank - 1, 1, MPI_COMM_WORLD, &reqs[req_count++]);
-    }
-
-    if (params.rank < params.size - 1) {
-        MPI_Isend(u_new_local[params.my_num_rows], params.N_total_pts, MPI_DOUBLE,
-                  params.rank + 1, 1, MPI_COMM_WORLD, &reqs[req_count++]);
-        MPI_Irecv(u_new_local[params.my_num_rows + 1], params.N_total_pts, MPI_DOUBLE,
-                  params.rank + 1, 0, MPI_COMM_WORLD, &reqs[req_count++]);
-    }
-    
-    if(req_count > 0) {
-        MPI_Waitall(req_count, reqs, stats);
-    }
-}
-
-void update_old_local_grid(double** u_old_local, double** u_new_local, const SimParamsMPI& params) {
-    for (int i_local = 0; i_local < params.my_num_rows + 2; ++i_local) {
-        memcpy(u_old_local[i_local], u_new_local[i_local], params.N_total_pts * sizeof(double));
-    }
-}
-
-void run_mpi_simulation(double** u_old_local, double** u_new_local, const SimParamsMPI& params) {
-    for (int iter = 0; iter < params.max_iterations; ++iter) {
-        perform_computation_step(u_old_local, u_new_local, params);
-        exchange_ghost_rows(u_new_local, params);
-        update_old_local_grid(u_old_local, u_new_local, params);
-    }
-}
-
-void gather_and_write_grid_to_file(double** u_local_final, const SimParamsMPI& params, const char* filename) {
-    double** global_grid = nullptr;
-    std::vector<int> recvcounts;
-    std::vector<int> displs;
-
-    if (params.rank == 0) {
-        global_grid = allocate_2d_array(params.N_total_pts, params.N_total_pts);
-        if (!global_grid) {
-            fprintf(stderr, "Rank 0: Failed to allocate memory for global grid.\n");
-            MPI_Abort(MPI_COMM_WORLD, 1);
-        }
-
-        recvcounts.resize(params.size);
-        displs.resize(params.size);
-        int current_displacement = 0;
-
-        for (int r = 0; r < params.size; ++r) {
-            int rows_on_proc_r = (params.N_total_pts / params.size) + (r < (params.N_total_pts % params.size) ? 1 : 0);
-            // We are gathering actual data rows, not ghost cells.
-            // Each row has N_total_pts columns.
-            recvcounts[r] = rows_on_proc_r * params.N_total_pts;
-            displs[r] = current_displacement;
-            current_displacement += recvcounts[r];
-        }
-    }
-
-    // Each process sends its actual data rows (from u_local_final[1] to u_local_final[params.my_num_rows])
-    // The data is contiguous in memory for these rows if allocate_2d_array stores it that way.
-    // We send params.my_num_rows * params.N_total_pts elements.
-    MPI_Gatherv(&u_local_final[1][0], params.my_num_rows * params.N_total_pts, MPI_DOUBLE,
-                global_grid ? &global_grid[0][0] : NULL, // Only rank 0 provides a valid receive buffer
-                recvcounts.data(), displs.data(), MPI_DOUBLE,
-                0, MPI_COMM_WORLD);
-
-    if (params.rank == 0) {
-        std::ofstream outfile(filename);
-        if (!outfile.is_open()) {
-            fprintf(stderr, "Rank 0: Error opening file %s for writing.\n", filename);
-        } else {
-            outfile << params.N_total_pts << " " << params.N_total_pts << std::endl;
-            for (int i = 0; i < params.N_total_pts; ++i) {
-                for (int j = 0; j < params.N_total_pts; ++j) {
-                    outfile << global_grid[i][j] << (j == params.N_total_pts - 1 ? "" : " ");
-                }
-                outfile << std::endl;
-            }
-            outfile.close();
-            printf("Rank 0: Final grid written to %s\n", filename);
-        }
-        free_2d_array(global_grid);
-    }
-}
-
-
-int main(int argc, char* argv[]) {
-    SimParamsMPI params;
-    params.n_global = 1000;       // Default global inner grid points
-    params.max_iterations = 1000; // Default iterations
-    params.c_const = 0.1;         // Default heat constant
-    // Initialize boundary values with defaults
-    params.boundary_top = 10.0;    // Default top boundary
-    params.boundary_bottom = 40.0; // Default bottom boundary
-    params.boundary_left = 20.0;   // Default left boundary
-    params.boundary_right = 30.0;  // Default right boundary
-
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &params.rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &params.size);
-
-    parse_mpi_arguments(argc, argv, params);
-    setup_mpi_simulation_parameters(params);
-
-    double** u_old_local = allocate_2d_array(params.my_num_rows + 2, params.N_total_pts);
-    double** u_new_local = allocate_2d_array(params.my_num_rows + 2, params.N_total_pts);
-
-    if (!u_old_local || !u_new_local) {
-        fprintf(stderr, "Rank %d: Failed to allocate memory.\n", params.rank);
-        MPI_Abort(MPI_COMM_WORLD, 1);
-    }
-
-    initialize_local_grid(u_old_local, u_new_local, params);
-
-    double start_time, end_time;
-    MPI_Barrier(MPI_COMM_WORLD);
-    start_time = MPI_Wtime();
-
-    run_mpi_simulation(u_old_local, u_new_local, params);
-
-    MPI_Barrier(MPI_COMM_WORLD);
-    end_time = MPI_Wtime();
-
-    gather_and_write_grid_to_file(u_new_local, params, "output_mpi.txt"); // Commented out
-
-    if (params.rank == 0) {
-        printf("Finished %d iterations for %dx%d grid (%d inner) in %f seconds using %d processes.\n",
-               params.max_iterations, params.N_total_pts, params.N_total_pts, params.n_global, end_time - start_time, params.size);
-        printf("Parameters: c=%.2f, ds=%.4f, dt=%.6f\n", params.c_const, params.ds, params.dt);
-        std::cout << std::fixed << std::setprecision(6) << (end_time - start_time) << std::endl;
-    }
-
-    free_2d_array(u_old_local);
-    free_2d_array(u_new_local);
-    MPI_Finalize();
-    return 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include <vector>   
+#include <deque>
+#include <string>
+#include <iostream>
+#include <iomanip> 
+#include "heat_kernel.h"
+#include "heat_grid.h"
+#include "heat_tiling.h"
+#include "heat_steady.h"
+#include "heat_io.h"
+#include "heat_adi.h"
+#include "heat_profile.h"
+#include "heat_snapshot.h"
+#include "heat_tuning.h"
+#include "heat_active.h"
+
+struct HaloPlan;
+
+struct SimParamsMPI {
+    int n_global;         // Number of INNER grid points globally
+    int N_total_pts;      // Total grid points including boundaries (n_global + 2)
+    int max_iterations;   // Number of time steps
+    double c_const;       // Heat constant
+    double ds;            // Spatial step (delta_s)
+    double dt;            // Time step (delta_t)
+    double coef;          // c * dt / ds^2, hoisted out of the stencil
+    double boundary_top;
+    double boundary_bottom;
+    double boundary_left;
+    double boundary_right;
+    double initial_value; // Interior initial condition
+    int rank;             // MPI rank of the current process (in cart_comm)
+    int size;             // Total number of MPI processes
+    int dims[2];          // Process grid: dims[0] rows x dims[1] columns (0 = auto)
+    int coords[2];        // Coordinates of this process in the process grid
+    MPI_Comm cart_comm;   // 2D Cartesian communicator
+    int nbr_up;           // Neighbor ranks (MPI_PROC_NULL on the global boundary)
+    int nbr_down;
+    int nbr_left;
+    int nbr_right;
+    int nbr_up_left;      // Diagonal neighbors, used for halo corners when halo_depth > 1
+    int nbr_up_right;
+    int nbr_down_left;
+    int nbr_down_right;
+    int halo_depth;       // Ghost layer depth k; halos are exchanged once every k steps
+    StencilTiling tiling; // Cache tiles for the k-1 steps between exchanges (0 = auto)
+    int num_threads;      // OpenMP threads per rank (0 = OMP_NUM_THREADS / default)
+    bool single_thread;   // MPI lacks MPI_THREAD_FUNNELED: one thread per rank, even if tuned otherwise
+    bool steady;          // Solve for the steady state with red-black SOR instead of time stepping
+    double omega;         // SOR over-relaxation factor (0 = optimal for the grid)
+    double tolerance;     // Steady state reached when the largest SOR correction drops below this
+    int check_every;      // Sweeps between (non-blocking) residual reductions
+    bool text_output;     // Also write the final grid as text (converted from the binary file)
+    HeatPrecision precision;   // Grid storage / arithmetic precision
+    int elem_size;             // Bytes per stored value (8 = double, 4 = float)
+    MPI_Datatype scalar_type;  // MPI_DOUBLE or MPI_FLOAT, matching elem_size
+    const char* checkpoint_file; // Checkpoint path (NULL = no checkpoints)
+    int checkpoint_every;        // Checkpoint every N iterations (0 = off)
+    double checkpoint_seconds;   // Checkpoint every T seconds of wall time (0 = off)
+    const char* restart_file;    // Checkpoint to resume from (NULL = fresh start)
+    int start_iteration;         // Iterations already done (from the restart checkpoint)
+    int snapshot_every;          // Write a snapshot every K iterations (0 = off)
+    const char* snapshot_prefix; // Snapshot files are <prefix><iteration>.bin
+    int snapshot_keep;           // Snapshots kept on disk, oldest deleted first (0 = all)
+    SnapshotLayout snapshot;     // Snapshot region and downsampling (rows = 0: whole grid)
+    bool autotune;               // Probe candidate configurations (or look them up) before the run
+    bool retune;                 // Probe again even if the tuning database has an entry
+    const char* tuning_db;       // Tuning database path
+    int autotune_steps;          // Time steps timed per probe
+    bool adi;             // Implicit Peaceman-Rachford ADI steps instead of the explicit stencil
+    double dt_request;    // --dt (0 = the explicit stability limit)
+    double end_time;      // --time: simulated time; overrides max_iterations when > 0
+    MPI_Comm row_comm;    // Ranks of this process row, ordered by column (ADI only)
+    MPI_Comm col_comm;    // Ranks of this process column, ordered by row (ADI only)
+    std::vector<int> row_starts; // Block p of the process grid spans global rows row_starts[p] .. row_starts[p + 1] - 1
+    std::vector<int> col_starts; // ... and columns col_starts[q] .. col_starts[q + 1] - 1
+    int rebalance_every;  // Iterations per load measurement window (0 = static decomposition)
+    double* compute_seconds; // Accumulates compute time for --rebalance (NULL = not measured)
+    int my_num_rows;      // Number of actual rows this process handles
+    int my_num_cols;      // Number of actual columns this process handles
+    int my_start_row_global; // Global starting row index for this process
+    int my_start_col_global; // Global starting column index for this process
+    int local_rows;       // Allocated local rows (my_num_rows + 2 * halo_depth)
+    int local_cols;       // Allocated local columns (my_num_cols + 2 * halo_depth)
+    int row_stride;       // Padded row length of the aligned local grids
+    bool stream_stores;   // Use non-temporal stores (grids larger than the LLC)
+    int ifirst_comp_local; // First local row index to compute
+    int ilast_comp_local;  // Last local row index to compute
+    int jfirst_comp_local; // First local column index to compute
+    int jlast_comp_local;  // Last local column index to compute
+    MPI_Datatype row_strip_type; // halo_depth rows x my_num_cols values
+    MPI_Datatype column_type;    // my_num_rows rows x halo_depth values (strided)
+    MPI_Datatype corner_type;    // halo_depth x halo_depth corner block
+    bool shared_halos;    // Read on-node neighbors' edges through a shared window (--no-shm turns off)
+    MPI_Comm node_comm;   // Ranks of cart_comm on this node (MPI_COMM_NULL = shared path off)
+    HaloPlan* halo;       // Persistent halo exchange of the current grids (set by run_solver)
+    bool active_tracking; // Skip tiles and halo exchanges the heat front has not reached (--no-active turns off)
+};
+
+// Outcome of a steady-state solve.
+struct SteadyResult {
+    int sweeps;           // Red-black sweeps performed
+    double residual;      // Largest global correction at the last completed check
+    bool converged;
+};
+
+// Positional arguments: n_global max_iterations top bottom left right.
+// Options (anywhere on the line):
+//   --dims RxC   process grid, e.g. 4x2; 0 lets MPI_Dims_create choose (e.g. 0x2)
+//   --halo K     ghost layer depth; halos are exchanged once every K steps (default 1)
+//   --tile RxC   cache tile size for the steps between exchanges (0 = auto)
+//   --tile-steps T   time steps advanced per tile; 1 disables tiling (default auto)
+//   --threads N  OpenMP threads per rank (needs -fopenmp; default OMP_NUM_THREADS)
+//   --steady     solve for the steady state with red-black SOR; max_iterations caps the sweeps
+//   --omega W    SOR factor in (0, 2) (default: optimal for the grid size)
+//   --tol E      steady-state tolerance on the largest correction (default 1e-6)
+//   --check-every N  sweeps between residual reductions (default 10)
+//   --text       also write output_mpi.txt next to the binary output_mpi.bin
+//   --rebalance W  measure compute time per rank over windows of W iterations and move
+//                  rows/columns between neighboring blocks to even it out
+//   --no-shm     exchange halos with on-node neighbors by messages instead of shared memory
+//   --no-active  update every point and exchange every halo from the first step
+//                (no active-region tracking)
+//   --precision P  double (default), float, or mixed (float storage and halo
+//                  messages, double arithmetic)
+//   --adi        implicit ADI time stepping; stable for any --dt
+//   --dt DT      time step (default and upper bound for the explicit stencil: ds^2 / (4c))
+//   --time T     simulate up to time T; sets max_iterations to ceil(T / dt)
+//   --initial V  initial value of the interior points (default 0)
+//   --checkpoint FILE        checkpoint path (default heat_checkpoint.ckp when a period is set)
+//   --checkpoint-every N     write a checkpoint every N iterations
+//   --checkpoint-seconds T   write a checkpoint every T seconds
+//   --snapshot-every K       write a snapshot of the grid every K iterations (background I/O)
+//   --snapshot-prefix P      snapshot file prefix (default snapshot_; files P<iteration>.bin)
+//   --snapshot-keep N        keep only the newest N snapshots on disk
+//   --snapshot-stride S      write every S-th row and column
+//   --snapshot-region R0,C0,RxC  write only the R x C global cells from (R0, C0)
+//   --autotune               pick the process grid, halo depth, tiles and threads per rank by
+//                            short timed probes, cached in the tuning database; overrides
+//                            --dims, --halo, --tile, --tile-steps and --threads
+//   --tune-db FILE           tuning database (default heat_tuning.db)
+//   --autotune-steps N       time steps per probe (default 50)
+//   --retune                 probe even if the database has an entry, and replace it
+//   --restart FILE           resume from a checkpoint (any rank count); the grid size, c and
+//                            boundaries come from the checkpoint, max_iterations from the
+//                            command line if given there (a lone positional argument is
+//                            max_iterations; a given n_global must match the checkpoint)
+void parse_mpi_arguments(int argc, char* argv[], SimParamsMPI& params) {
+    int positional = 0;
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--dims") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%dx%d", &params.dims[0], &params.dims[1]) != 2) {
+                params.dims[0] = params.dims[1] = 0;
+            }
+            continue;
+        }
+        if (strcmp(argv[a], "--halo") == 0 && a + 1 < argc) {
+            params.halo_depth = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--tile") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%dx%d", &params.tiling.tile_rows, &params.tiling.tile_cols) != 2) {
+                params.tiling.tile_rows = params.tiling.tile_cols = 0;
+            }
+            continue;
+        }
+        if (strcmp(argv[a], "--tile-steps") == 0 && a + 1 < argc) {
+            params.tiling.time_steps = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            params.num_threads = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--steady") == 0) {
+            params.steady = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--text") == 0) {
+            params.text_output = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--rebalance") == 0 && a + 1 < argc) {
+            params.rebalance_every = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--no-shm") == 0) {
+            params.shared_halos = false;
+            continue;
+        }
+        if (strcmp(argv[a], "--no-active") == 0) {
+            params.active_tracking = false;
+            continue;
+        }
+        if (strcmp(argv[a], "--checkpoint") == 0 && a + 1 < argc) {
+            params.checkpoint_file = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--checkpoint-every") == 0 && a + 1 < argc) {
+            params.checkpoint_every = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--checkpoint-seconds") == 0 && a + 1 < argc) {
+            params.checkpoint_seconds = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--snapshot-every") == 0 && a + 1 < argc) {
+            params.snapshot_every = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--snapshot-prefix") == 0 && a + 1 < argc) {
+            params.snapshot_prefix = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--snapshot-keep") == 0 && a + 1 < argc) {
+            params.snapshot_keep = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--snapshot-stride") == 0 && a + 1 < argc) {
+            params.snapshot.stride = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--snapshot-region") == 0 && a + 1 < argc) {
+            SnapshotLayout& r = params.snapshot;
+            if (sscanf(argv[++a], "%d,%d,%dx%d", &r.row0, &r.col0, &r.rows, &r.cols) != 4) {
+                if (params.rank == 0) fprintf(stderr, "Invalid snapshot region %s (use R0,C0,RxC).\n", argv[a]);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            continue;
+        }
+        if (strcmp(argv[a], "--autotune") == 0) {
+            params.autotune = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--retune") == 0) {
+            params.autotune = params.retune = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--tune-db") == 0 && a + 1 < argc) {
+            params.tuning_db = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--autotune-steps") == 0 && a + 1 < argc) {
+            params.autotune_steps = atoi(argv[++a]);
+            if (params.autotune_steps < 1) {
+                if (params.rank == 0) fprintf(stderr, "Invalid autotune steps %s (use a count of at least 1).\n", argv[a]);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            continue;
+        }
+        if (strcmp(argv[a], "--restart") == 0 && a + 1 < argc) {
+            params.restart_file = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--omega") == 0 && a + 1 < argc) {
+            params.omega = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--tol") == 0 && a + 1 < argc) {
+            params.tolerance = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--check-every") == 0 && a + 1 < argc) {
+            params.check_every = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--adi") == 0) {
+            params.adi = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--dt") == 0 && a + 1 < argc) {
+            params.dt_request = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--time") == 0 && a + 1 < argc) {
+            params.end_time = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--initial") == 0 && a + 1 < argc) {
+            params.initial_value = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--precision") == 0 && a + 1 < argc) {
+            if (!parse_heat_precision(argv[++a], params.precision)) {
+                if (params.rank == 0) fprintf(stderr, "Unknown precision %s (use double, float or mixed).\n", argv[a]);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            continue;
+        }
+        switch (++positional) {
+            case 1: params.n_global = atoi(argv[a]); break;
+            case 2: params.max_iterations = atoi(argv[a]); break;
+            case 3: params.boundary_top = atof(argv[a]); break;
+            case 4: params.boundary_bottom = atof(argv[a]); break;
+            case 5: params.boundary_left = atof(argv[a]); break;
+            case 6: params.boundary_right = atof(argv[a]); break;
+            default: break;
+        }
+    }
+    if (params.restart_file && positional < 2) {
+        // A lone positional argument is the iteration count; the rest comes from the checkpoint
+        params.max_iterations = positional == 1 ? params.n_global : -1;
+        params.n_global = 0;
+    }
+}
+
+// Splits n points into `parts` contiguous blocks; the first (n % parts) blocks get one extra.
+void block_decompose(int n, int parts, int idx, int& start, int& count) {
+    int base = n / parts;
+    int remainder = n % parts;
+    count = base + (idx < remainder ? 1 : 0);
+    start = idx * base + (idx < remainder ? idx : remainder);
+}
+
+// Splits the n_global computed points of one dimension into `parts` blocks
+// that differ by at most one point and adds the two boundary points to the
+// first and last block. Returns the block starts (parts + 1 entries, the last
+// is n_global + 2). Balancing computed points rather than all points keeps
+// the boundary blocks, which never update their boundary row, from idling.
+std::vector<int> work_decompose(int n_global, int parts) {
+    std::vector<int> starts(parts + 1);
+    for (int p = 0; p < parts; ++p) {
+        int start, count;
+        block_decompose(n_global, parts, p, start, count);
+        starts[p] = p == 0 ? 0 : 1 + start;
+    }
+    starts[parts] = n_global + 2;
+    return starts;
+}
+
+// Smallest block in a decomposition.
+int smallest_block(const std::vector<int>& starts) {
+    int smallest = starts[1] - starts[0];
+    for (size_t p = 1; p + 1 < starts.size(); ++p) {
+        if (starts[p + 1] - starts[p] < smallest) smallest = starts[p + 1] - starts[p];
+    }
+    return smallest;
+}
+
+// Rank at offset (drow, dcol) in the process grid, or MPI_PROC_NULL outside it.
+int cart_neighbor(const SimParamsMPI& params, int drow, int dcol) {
+    int nbr_coords[2] = {params.coords[0] + drow, params.coords[1] + dcol};
+    if (nbr_coords[0] < 0 || nbr_coords[0] >= params.dims[0] ||
+        nbr_coords[1] < 0 || nbr_coords[1] >= params.dims[1]) {
+        return MPI_PROC_NULL;
+    }
+    int nbr_rank;
+    MPI_Cart_rank(params.cart_comm, nbr_coords, &nbr_rank);
+    return nbr_rank;
+}
+
+// Local index range [i0, i1] x [j0, j1] updated by a step that reaches `ext`
+// cells into the halo. Global boundary rows and columns are never updated.
+void get_compute_range(const SimParamsMPI& params, int ext, int& i0, int& i1, int& j0, int& j1) {
+    int h = params.halo_depth;
+    int row_offset = h - params.my_start_row_global; // local index = global index + offset
+    int col_offset = h - params.my_start_col_global;
+    int last_inner = params.N_total_pts - 2;
+
+    i0 = h - ext > 1 + row_offset ? h - ext : 1 + row_offset;
+    i1 = h + params.my_num_rows - 1 + ext < last_inner + row_offset ? h + params.my_num_rows - 1 + ext : last_inner + row_offset;
+    j0 = h - ext > 1 + col_offset ? h - ext : 1 + col_offset;
+    j1 = h + params.my_num_cols - 1 + ext < last_inner + col_offset ? h + params.my_num_cols - 1 + ext : last_inner + col_offset;
+}
+
+// True if the block at (prow, pcol) of the process grid, halo included, still
+// holds the initial values after `iteration` steps of a fresh run: the front
+// starts at the global boundary and moves one cell per step, so it has not
+// reached a cell more than `iteration` cells away from the boundary.
+bool block_untouched(const SimParamsMPI& params, int prow, int pcol, int iteration) {
+    int h = params.halo_depth;
+    int last = params.N_total_pts - 1;
+    int distance = params.row_starts[prow] - h;
+    if (params.col_starts[pcol] - h < distance) distance = params.col_starts[pcol] - h;
+    if (last - (params.row_starts[prow + 1] - 1 + h) < distance) distance = last - (params.row_starts[prow + 1] - 1 + h);
+    if (last - (params.col_starts[pcol + 1] - 1 + h) < distance) distance = last - (params.col_starts[pcol + 1] - 1 + h);
+    return distance > iteration;
+}
+
+// Derives this rank's block, its local array sizes, compute range and halo
+// datatypes from params.row_starts / col_starts. Called at setup and after
+// every rebalance (`replace` frees the previous datatypes).
+void apply_decomposition(SimParamsMPI& params, bool replace) {
+    int h = params.halo_depth;
+    params.my_start_row_global = params.row_starts[params.coords[0]];
+    params.my_num_rows = params.row_starts[params.coords[0] + 1] - params.my_start_row_global;
+    params.my_start_col_global = params.col_starts[params.coords[1]];
+    params.my_num_cols = params.col_starts[params.coords[1] + 1] - params.my_start_col_global;
+    params.local_rows = params.my_num_rows + 2 * h;
+    params.local_cols = params.my_num_cols + 2 * h;
+    params.row_stride = aligned_grid_stride(params.local_cols, params.elem_size);
+    params.stream_stores = stencil_use_streaming((size_t)params.local_rows * params.row_stride * params.elem_size);
+
+    //Determine computation range (ifirst, ilast) x (jfirst, jlast) of the owned block
+    get_compute_range(params, 0, params.ifirst_comp_local, params.ilast_comp_local,
+                      params.jfirst_comp_local, params.jlast_comp_local);
+
+    if (replace) {
+        MPI_Type_free(&params.row_strip_type);
+        MPI_Type_free(&params.column_type);
+        MPI_Type_free(&params.corner_type);
+    }
+    MPI_Type_vector(h, params.my_num_cols, params.row_stride, params.scalar_type, &params.row_strip_type);
+    MPI_Type_commit(&params.row_strip_type);
+    MPI_Type_vector(params.my_num_rows, h, params.row_stride, params.scalar_type, &params.column_type);
+    MPI_Type_commit(&params.column_type);
+    MPI_Type_vector(h, h, params.row_stride, params.scalar_type, &params.corner_type);
+    MPI_Type_commit(&params.corner_type);
+}
+
+void setup_mpi_simulation_parameters(SimParamsMPI& params) {
+    params.N_total_pts = params.n_global + 2;
+    params.ds = 1.0 / (params.n_global + 1);
+    params.dt = (params.ds * params.ds) / (4.0 * params.c_const);
+    if (params.adi && params.steady) {
+        if (params.rank == 0) fprintf(stderr, "--adi and --steady cannot be combined.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (params.dt_request > 0.0) {
+        // The explicit stencil diverges above the limit; ADI is stable for any dt
+        if (!params.adi && params.dt_request > params.dt * (1.0 + 1e-12)) {
+            if (params.rank == 0) {
+                fprintf(stderr, "dt %g exceeds the explicit stability limit %g; use --adi for larger steps.\n",
+                        params.dt_request, params.dt);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        params.dt = params.dt_request;
+    }
+    if (params.end_time > 0.0) params.max_iterations = (int)ceil(params.end_time / params.dt - 1e-9);
+    params.coef = params.c_const * params.dt / (params.ds * params.ds);
+    if (params.omega <= 0.0 || params.omega >= 2.0) params.omega = sor_optimal_omega(params.n_global);
+    if (params.check_every < 1) params.check_every = 1;
+    if (!params.checkpoint_file && (params.checkpoint_every > 0 || params.checkpoint_seconds > 0.0)) {
+        params.checkpoint_file = "heat_checkpoint.ckp";
+    }
+
+    //Process grid and Cartesian topology
+    int fixed_procs = (params.dims[0] > 0 ? params.dims[0] : 1) * (params.dims[1] > 0 ? params.dims[1] : 1);
+    if (params.dims[0] < 0 || params.dims[1] < 0 || params.size % fixed_procs != 0 ||
+        MPI_Dims_create(params.size, 2, params.dims) != MPI_SUCCESS ||
+        params.dims[0] * params.dims[1] != params.size) {
+        if (params.rank == 0) {
+            fprintf(stderr, "Invalid process grid %dx%d for %d processes.\n", params.dims[0], params.dims[1], params.size);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (params.dims[0] > params.n_global || params.dims[1] > params.n_global) {
+        if (params.rank == 0) {
+            fprintf(stderr, "Process grid %dx%d is larger than the %dx%d inner grid.\n",
+                    params.dims[0], params.dims[1], params.n_global, params.n_global);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    int periods[2] = {0, 0};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, params.dims, periods, 0, &params.cart_comm);
+    MPI_Comm_rank(params.cart_comm, &params.rank);
+    MPI_Cart_coords(params.cart_comm, params.rank, 2, params.coords);
+    MPI_Cart_shift(params.cart_comm, 0, 1, &params.nbr_up, &params.nbr_down);
+    MPI_Cart_shift(params.cart_comm, 1, 1, &params.nbr_left, &params.nbr_right);
+
+    // Ranks sharing a node exchange halos through shared memory (only worth it with company)
+    params.node_comm = MPI_COMM_NULL;
+    if (params.shared_halos) {
+        int node_size;
+        MPI_Comm_split_type(params.cart_comm, MPI_COMM_TYPE_SHARED, params.rank, MPI_INFO_NULL, &params.node_comm);
+        MPI_Comm_size(params.node_comm, &node_size);
+        if (node_size < 2) MPI_Comm_free(&params.node_comm);
+    }
+
+    params.row_comm = MPI_COMM_NULL;
+    params.col_comm = MPI_COMM_NULL;
+    if (params.adi) {
+        int keep_cols[2] = {0, 1};
+        int keep_rows[2] = {1, 0};
+        MPI_Cart_sub(params.cart_comm, keep_cols, &params.row_comm);
+        MPI_Cart_sub(params.cart_comm, keep_rows, &params.col_comm);
+    }
+
+    params.nbr_up_left = cart_neighbor(params, -1, -1);
+    params.nbr_up_right = cart_neighbor(params, -1, 1);
+    params.nbr_down_left = cart_neighbor(params, 1, -1);
+    params.nbr_down_right = cart_neighbor(params, 1, 1);
+
+    //Domain Decomposition
+    params.row_starts = work_decompose(params.n_global, params.dims[0]);
+    params.col_starts = work_decompose(params.n_global, params.dims[1]);
+
+    // Neighbors fill the halo from their own blocks, so every block must be at least halo_depth wide
+    int h = params.halo_depth;
+    int min_rows = smallest_block(params.row_starts), min_cols = smallest_block(params.col_starts);
+    if (h < 1 || min_rows < h || min_cols < h) {
+        if (params.rank == 0) {
+            fprintf(stderr, "Halo depth %d must be at least 1 and at most the smallest block size (%dx%d).\n",
+                    h, min_rows, min_cols);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (params.snapshot_every > 0) {
+        // Region in global cells, then its size in snapshot cells
+        SnapshotLayout& s = params.snapshot;
+        if (s.rows == 0) {
+            s.row0 = s.col0 = 0;
+            s.rows = s.cols = params.N_total_pts;
+        }
+        if (s.stride < 1 || s.row0 < 0 || s.col0 < 0 || s.rows < 1 || s.cols < 1 ||
+            s.row0 + s.rows > params.N_total_pts || s.col0 + s.cols > params.N_total_pts) {
+            if (params.rank == 0) {
+                fprintf(stderr, "Snapshot region %d,%d,%dx%d (stride %d) does not fit the %dx%d grid.\n",
+                        s.row0, s.col0, s.rows, s.cols, s.stride, params.N_total_pts, params.N_total_pts);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        s.rows = (s.rows + s.stride - 1) / s.stride;
+        s.cols = (s.cols + s.stride - 1) / s.stride;
+        if (params.steady) {
+            if (params.rank == 0) fprintf(stderr, "--snapshot-every applies to time stepping only; ignored.\n");
+            params.snapshot_every = 0;
+        }
+    }
+    if (params.rebalance_every > 0 && (params.steady || params.adi)) {
+        if (params.rank == 0) fprintf(stderr, "--rebalance applies to explicit time stepping only; ignored.\n");
+        params.rebalance_every = 0;
+    }
+    params.elem_size = (int)heat_precision_elem_size(params.precision);
+    params.scalar_type = params.elem_size == (int)sizeof(float) ? MPI_FLOAT : MPI_DOUBLE;
+    apply_decomposition(params, false);
+    heat_set_num_threads(params.num_threads);
+    params.tiling = stencil_auto_tiling(params.local_rows, params.local_cols, params.tiling, params.elem_size);
+
+    // if (params.rank == 0) {
+    //     printf("Running 2D Heat Equation (MPI Parallel)");
+    //     printf("Global Grid: %dx%d total points (%dx%d inner points)\n", params.N_total_pts, params.N_total_pts, params.n_global, params.n_global);
+    //     printf("Iterations: %d\n", params.max_iterations);
+    //     printf("c = %.2f, ds = %.4f, dt = %.6f\n", params.c_const, params.ds, params.dt);
+    //     printf("MPI Processes: %d\n", params.size);
+    //     printf("Boundaries: T=%.1f, B=%.1f, L=%.1f, R=%.1f\n", params.boundary_top, params.boundary_bottom, params.boundary_left, params.boundary_right);
+    // }
+}
+
+// Releases what setup_mpi_simulation_parameters created.
+void free_mpi_simulation(SimParamsMPI& params) {
+    MPI_Type_free(&params.row_strip_type);
+    MPI_Type_free(&params.column_type);
+    MPI_Type_free(&params.corner_type);
+    if (params.node_comm != MPI_COMM_NULL) MPI_Comm_free(&params.node_comm);
+    if (params.row_comm != MPI_COMM_NULL) MPI_Comm_free(&params.row_comm);
+    if (params.col_comm != MPI_COMM_NULL) MPI_Comm_free(&params.col_comm);
+    MPI_Comm_free(&params.cart_comm);
+}
+
+// Fills every local cell, halo included, so global boundary values that fall
+// inside the halo are present in both buffers for the whole run.
+template <typename T>
+void initialize_local_grid(T** u_old_local, T** u_new_local, const SimParamsMPI& params) {
+    int h = params.halo_depth;
+    heat_initialize_levels(u_old_local, u_new_local, params.local_rows, params.local_cols,
+                           params.my_start_row_global - h, params.my_start_col_global - h, params);
+}
+
+// Updates the local cells in rows [i_begin, i_end] x columns [j_begin, j_end]
+// (inclusive). With `active`, only the tiles the front has reached.
+template <typename T, typename Acc>
+void compute_region(T** u_old_local, T** u_new_local, const SimParamsMPI& params,
+                    int i_begin, int i_end, int j_begin, int j_end, ActiveTiles<T>* active = NULL) {
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_COMPUTE);
+    double start = params.compute_seconds ? MPI_Wtime() : 0.0;
+    if (active) {
+        active_tiles_step<T, Acc>(*active, u_old_local, u_new_local, i_begin, i_end, j_begin, j_end, params.coef);
+    } else {
+        HeatStencil<T, Acc, 1, HEAT_FIXED_WIDTH>::region(u_old_local, u_new_local, i_begin, i_end, j_begin, j_end,
+                                                         params.coef, params.stream_stores);
+    }
+    if (params.compute_seconds) *params.compute_seconds += MPI_Wtime() - start;
+}
+
+// Updates the owned block plus `ext` cells into the halo.
+template <typename T, typename Acc>
+void perform_computation_step(T** u_old_local, T** u_new_local, const SimParamsMPI& params, int ext,
+                              ActiveTiles<T>* active = NULL) {
+    int i0, i1, j0, j1;
+    get_compute_range(params, ext, i0, i1, j0, j1);
+    compute_region<T, Acc>(u_old_local, u_new_local, params, i0, i1, j0, j1, active);
+}
+
+// Halo exchange plan, built once per run for the two local grids.
+// Off-node neighbors are served by persistent requests (MPI_Send_init /
+// MPI_Recv_init on the derived types), one set per grid, so an exchange is a
+// single MPI_Startall. Neighbors on the same node (MPI_Comm_split_type) are
+// not messaged at all: both grids live in an MPI-3 shared window, and each
+// rank copies the neighbor's edge straight into its own ghost cells. Those
+// copies are bracketed by two zero-byte persistent flag messages per
+// neighbor: "ready" (my edge of this grid is final), posted when the exchange
+// starts, and "done" (I have finished reading yours), sent after the copies.
+// An exchange returns only after every on-node neighbor is done, so no rank
+// overwrites an edge that is still being read.
+struct SharedHaloCopy {
+    const char* src;      // Neighbor's first source row (mapped into this process)
+    char* dst;            // First ghost row to fill
+    size_t src_pitch;     // Row pitches in bytes
+    size_t dst_pitch;
+    int rows;
+    size_t row_bytes;
+};
+
+struct HaloPlan {
+    char* grid_base[2];          // First cell of each local grid the plan is bound to
+    MPI_Request data[2][16];     // Per grid: persistent sends/receives to off-node neighbors
+    int data_count;
+    SharedHaloCopy copies[2][8]; // Per grid: edges read from on-node neighbors
+    int copy_count;
+    MPI_Request ready[16];       // Flag sends/receives to on-node neighbors
+    MPI_Request done[16];
+    int flag_count;
+    MPI_Win win;                 // Shared window holding both grids (MPI_WIN_NULL = private grids)
+    int active;                  // Grid of the exchange in flight (-1 = none)
+    int data_offset[8][2];       // Process-grid offset of the neighbor of each send/receive pair
+    int copy_offset[8][2];       // ... and of each on-node neighbor (copy, flag pairs)
+    int front;                   // Iteration of a fresh run whose exchange this is: pairs where
+                                 // either block is untouched are skipped (-1 = exchange all)
+};
+
+// Bytes one local grid of a rank with the given block occupies in the shared
+// window (whole 64-byte lines, so the second grid starts aligned too).
+size_t shared_grid_bytes(const SimParamsMPI& params, int num_rows, int num_cols) {
+    int h = params.halo_depth;
+    size_t bytes = (size_t)(num_rows + 2 * h) * aligned_grid_stride(num_cols + 2 * h, params.elem_size) * params.elem_size;
+    return (bytes + HEAT_GRID_ALIGNMENT - 1) / HEAT_GRID_ALIGNMENT * HEAT_GRID_ALIGNMENT;
+}
+
+// First 64-byte boundary in a window segment. Segments are mapped page by page,
+// so every process that maps a segment computes the same offset.
+char* shared_segment_start(void* base) {
+    size_t misalignment = (size_t)((uintptr_t)base % HEAT_GRID_ALIGNMENT);
+    return (char*)base + (misalignment ? HEAT_GRID_ALIGNMENT - misalignment : 0);
+}
+
+// Allocates the two local grids: in this rank's segment of a shared window
+// when on-node neighbors read them (params.node_comm), otherwise as private
+// aligned grids. Collective over params.node_comm.
+template <typename T>
+void allocate_local_grids(const SimParamsMPI& params, HaloPlan& plan, HeatGrid<T> grids[2]) {
+    int h = params.halo_depth;
+    bool allocated = true;
+    plan.win = MPI_WIN_NULL;
+    if (params.node_comm == MPI_COMM_NULL) {
+        for (int g = 0; g < 2; ++g) {
+            allocated = grids[g].allocate(params.my_num_rows, params.my_num_cols, h) && allocated;
+        }
+    } else {
+        size_t grid_bytes = shared_grid_bytes(params, params.my_num_rows, params.my_num_cols);
+        MPI_Info info;
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "alloc_shared_noncontig", "true"); // Segments on the owner's NUMA node
+        void* base = NULL;
+        MPI_Win_allocate_shared((MPI_Aint)(2 * grid_bytes + HEAT_GRID_ALIGNMENT), 1, info, params.node_comm,
+                                &base, &plan.win);
+        MPI_Info_free(&info);
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, plan.win); // Passive epoch for MPI_Win_sync
+        char* start = shared_segment_start(base);
+        for (int g = 0; g < 2; ++g) {
+            allocated = grids[g].wrap((T*)(start + g * grid_bytes), params.my_num_rows, params.my_num_cols, h) && allocated;
+        }
+    }
+    if (!allocated) {
+        fprintf(stderr, "Rank %d: Failed to allocate memory.\n", params.rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+// Builds the plan for grids[0] and grids[1]: persistent requests for
+// off-node neighbors, copy descriptors and flag requests for on-node ones.
+// Corners are only needed (and only exchanged) when halo_depth > 1, since a
+// single 5-point step never reads them.
+template <typename T>
+void create_halo_plan(HaloPlan& plan, T** const grids[2], const SimParamsMPI& params) {
+    int h = params.halo_depth;
+    int rows = params.my_num_rows;
+    int cols = params.my_num_cols;
+    plan.data_count = plan.copy_count = plan.flag_count = 0;
+    plan.active = -1;
+    plan.front = -1;
+    for (int g = 0; g < 2; ++g) plan.grid_base[g] = (char*)grids[g][0];
+
+    MPI_Group cart_group = MPI_GROUP_NULL, node_group = MPI_GROUP_NULL;
+    if (plan.win != MPI_WIN_NULL) {
+        MPI_Comm_group(params.cart_comm, &cart_group);
+        MPI_Comm_group(params.node_comm, &node_group);
+    }
+
+    // Tags name the direction a message travels; a receive from a neighbor
+    // expects the direction pointing back at this rank. Flags add 8 (ready)
+    // or 16 (done).
+    enum { UP, DOWN, LEFT, RIGHT, UP_LEFT, UP_RIGHT, DOWN_LEFT, DOWN_RIGHT };
+    struct HaloMessage {
+        int nbr;
+        int drow, dcol;   // Neighbor's offset in the process grid
+        int send_row, send_col;
+        int recv_row, recv_col;
+        MPI_Datatype type;
+        int send_tag;
+        int recv_tag;
+    } messages[8] = {
+        {params.nbr_up, -1, 0, h, h, 0, h, params.row_strip_type, UP, DOWN},
+        {params.nbr_down, 1, 0, rows, h, rows + h, h, params.row_strip_type, DOWN, UP},
+        {params.nbr_left, 0, -1, h, h, h, 0, params.column_type, LEFT, RIGHT},
+        {params.nbr_right, 0, 1, h, cols, h, cols + h, params.column_type, RIGHT, LEFT},
+        {params.nbr_up_left, -1, -1, h, h, 0, 0, params.corner_type, UP_LEFT, DOWN_RIGHT},
+        {params.nbr_up_right, -1, 1, h, cols, 0, cols + h, params.corner_type, UP_RIGHT, DOWN_LEFT},
+        {params.nbr_down_left, 1, -1, rows, h, rows + h, 0, params.corner_type, DOWN_LEFT, UP_RIGHT},
+        {params.nbr_down_right, 1, 1, rows, cols, rows + h, cols + h, params.corner_type, DOWN_RIGHT, UP_LEFT},
+    };
+    int num_messages = h > 1 ? 8 : 4;
+
+    for (int m = 0; m < num_messages; ++m) {
+        const HaloMessage& msg = messages[m];
+        if (msg.nbr == MPI_PROC_NULL) continue;
+        int node_rank = MPI_UNDEFINED;
+        if (plan.win != MPI_WIN_NULL) {
+            MPI_Group_translate_ranks(cart_group, 1, &msg.nbr, node_group, &node_rank);
+        }
+
+        if (node_rank == MPI_UNDEFINED) {
+            for (int g = 0; g < 2; ++g) {
+                MPI_Send_init(&grids[g][msg.send_row][msg.send_col], 1, msg.type, msg.nbr, msg.send_tag,
+                              params.cart_comm, &plan.data[g][plan.data_count]);
+                MPI_Recv_init(&grids[g][msg.recv_row][msg.recv_col], 1, msg.type, msg.nbr, msg.recv_tag,
+                              params.cart_comm, &plan.data[g][plan.data_count + 1]);
+            }
+            plan.data_offset[plan.data_count / 2][0] = msg.drow;
+            plan.data_offset[plan.data_count / 2][1] = msg.dcol;
+            plan.data_count += 2;
+            continue;
+        }
+
+        // The neighbor's block, and the part of it this rank's ghost cells mirror:
+        // its last h rows (columns) toward this rank, or the whole shared extent
+        int nbr_row = params.coords[0] + msg.drow, nbr_col = params.coords[1] + msg.dcol;
+        int nbr_rows = params.row_starts[nbr_row + 1] - params.row_starts[nbr_row];
+        int nbr_cols = params.col_starts[nbr_col + 1] - params.col_starts[nbr_col];
+        int src_row = msg.drow < 0 ? nbr_rows : h;
+        int src_col = msg.dcol < 0 ? nbr_cols : h;
+        int copy_rows = msg.drow != 0 ? h : rows;
+        int copy_cols = msg.dcol != 0 ? h : cols;
+        size_t nbr_pitch = (size_t)aligned_grid_stride(nbr_cols + 2 * h, params.elem_size) * params.elem_size;
+        size_t nbr_grid_bytes = shared_grid_bytes(params, nbr_rows, nbr_cols);
+        MPI_Aint segment_size;
+        int disp_unit;
+        void* nbr_base = NULL;
+        MPI_Win_shared_query(plan.win, node_rank, &segment_size, &disp_unit, &nbr_base);
+        for (int g = 0; g < 2; ++g) {
+            SharedHaloCopy& copy = plan.copies[g][plan.copy_count];
+            copy.src = shared_segment_start(nbr_base) + g * nbr_grid_bytes + src_row * nbr_pitch + (size_t)src_col * params.elem_size;
+            copy.dst = (char*)&grids[g][msg.recv_row][msg.recv_col];
+            copy.src_pitch = nbr_pitch;
+            copy.dst_pitch = (size_t)params.row_stride * params.elem_size;
+            copy.rows = copy_rows;
+            copy.row_bytes = (size_t)copy_cols * params.elem_size;
+        }
+        plan.copy_offset[plan.copy_count][0] = msg.drow;
+        plan.copy_offset[plan.copy_count][1] = msg.dcol;
+        plan.copy_count++;
+        MPI_Send_init(NULL, 0, MPI_BYTE, msg.nbr, msg.send_tag + 8, params.cart_comm, &plan.ready[plan.flag_count]);
+        MPI_Recv_init(NULL, 0, MPI_BYTE, msg.nbr, msg.recv_tag + 8, params.cart_comm, &plan.ready[plan.flag_count + 1]);
+        MPI_Send_init(NULL, 0, MPI_BYTE, msg.nbr, msg.send_tag + 16, params.cart_comm, &plan.done[plan.flag_count]);
+        MPI_Recv_init(NULL, 0, MPI_BYTE, msg.nbr, msg.recv_tag + 16, params.cart_comm, &plan.done[plan.flag_count + 1]);
+        plan.flag_count += 2;
+    }
+
+    if (cart_group != MPI_GROUP_NULL) MPI_Group_free(&cart_group);
+    if (node_group != MPI_GROUP_NULL) MPI_Group_free(&node_group);
+}
+
+// Releases the requests and, with the shared path, the window that holds the
+// grid cells; the grids must not be used afterwards. Private grids are freed
+// by their HeatGrid objects.
+void free_halo_plan(HaloPlan& plan) {
+    for (int g = 0; g < 2; ++g) {
+        for (int r = 0; r < plan.data_count; ++r) MPI_Request_free(&plan.data[g][r]);
+    }
+    for (int r = 0; r < plan.flag_count; ++r) {
+        MPI_Request_free(&plan.ready[r]);
+        MPI_Request_free(&plan.done[r]);
+    }
+    if (plan.win != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(plan.win);
+        MPI_Win_free(&plan.win);
+    }
+}
+
+// The two local grids and the halo plan bound to them, rebuilt together when
+// the decomposition changes.
+template <typename T>
+struct LocalGrids {
+    HeatGrid<T> grid[2];
+    HaloPlan plan;
+};
+
+// Allocates the local grids for the layout in params and plans their halo
+// exchange (params.halo). Collective.
+template <typename T>
+void create_local_grids(LocalGrids<T>& local, SimParamsMPI& params) {
+    allocate_local_grids(params, local.plan, local.grid);
+    T** const grids[2] = {local.grid[0].data(), local.grid[1].data()};
+    create_halo_plan(local.plan, grids, params);
+    params.halo = &local.plan;
+}
+
+// True if the exchange with the neighbor at `offset` changes nothing: at
+// iteration plan.front of a fresh run, this rank's or the neighbor's block is
+// untouched, so every cell either side sends equals the copy the other holds.
+// Both sides come to the same answer, so neither posts its half.
+bool halo_pair_idle(const SimParamsMPI& params, const int offset[2]) {
+    int front = params.halo->front;
+    return front >= 0 && (block_untouched(params, params.coords[0], params.coords[1], front) ||
+                          block_untouched(params, params.coords[0] + offset[0], params.coords[1] + offset[1], front));
+}
+
+// Starts the send/receive pairs of `requests` (count entries) except those
+// with idle neighbors. Idle pairs stay inactive, which MPI_Waitall and
+// MPI_Testall treat as complete.
+void start_halo_pairs(MPI_Request* requests, int count, const int (*offsets)[2], const SimParamsMPI& params) {
+    if (params.halo->front < 0) {
+        MPI_Startall(count, requests);
+        return;
+    }
+    for (int r = 0; r < count; r += 2) {
+        if (!halo_pair_idle(params, offsets[r / 2])) MPI_Startall(2, &requests[r]);
+    }
+}
+
+// Starts the halo exchange of u_local (one of the two planned grids) and
+// returns without waiting.
+template <typename T>
+void start_ghost_exchange(T** u_local, const SimParamsMPI& params) {
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_HALO_POST);
+    HaloPlan& plan = *params.halo;
+    plan.active = (char*)u_local[0] == plan.grid_base[0] ? 0 : 1;
+    if (plan.data_count > 0) {
+        start_halo_pairs(plan.data[plan.active], plan.data_count, plan.data_offset, params);
+    }
+    if (plan.flag_count > 0) {
+        MPI_Win_sync(plan.win); // Publish this rank's edge before announcing it
+        start_halo_pairs(plan.ready, plan.flag_count, plan.copy_offset, params);
+    }
+}
+
+// Drives the off-node messages of the exchange in flight; true once they
+// have all arrived.
+bool test_ghost_exchange(const SimParamsMPI& params) {
+    HaloPlan& plan = *params.halo;
+    int done = 1;
+    if (plan.data_count > 0) {
+        MPI_Testall(plan.data_count, plan.data[plan.active], &done, MPI_STATUSES_IGNORE);
+    }
+    return done != 0;
+}
+
+// Completes the exchange in flight: waits for the off-node messages, copies
+// the on-node neighbors' edges once they are ready, and returns when those
+// neighbors have finished reading this rank's edges.
+void finish_ghost_exchange(const SimParamsMPI& params) {
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_HALO_WAIT);
+    HaloPlan& plan = *params.halo;
+    if (plan.data_count > 0) {
+        MPI_Waitall(plan.data_count, plan.data[plan.active], MPI_STATUSES_IGNORE);
+    }
+    if (plan.flag_count > 0) {
+        MPI_Waitall(plan.flag_count, plan.ready, MPI_STATUSES_IGNORE);
+        MPI_Win_sync(plan.win); // See the neighbors' edges as of their "ready"
+        for (int c = 0; c < plan.copy_count; ++c) {
+            if (plan.front >= 0 && halo_pair_idle(params, plan.copy_offset[c])) continue;
+            const SharedHaloCopy& copy = plan.copies[plan.active][c];
+            for (int r = 0; r < copy.rows; ++r) {
+                memcpy(copy.dst + r * copy.dst_pitch, copy.src + r * copy.src_pitch, copy.row_bytes);
+            }
+        }
+        start_halo_pairs(plan.done, plan.flag_count, plan.copy_offset, params);
+        MPI_Waitall(plan.flag_count, plan.done, MPI_STATUSES_IGNORE);
+    }
+    plan.active = -1;
+}
+
+template <typename T>
+void exchange_ghost_rows(T** u_new_local, const SimParamsMPI& params) {
+    start_ghost_exchange(u_new_local, params);
+    finish_ghost_exchange(params);
+}
+
+// Re-checks the activity of the ghost cells an exchange of u_local just wrote.
+template <typename T>
+void refresh_ghost_tiles(ActiveTiles<T>& active, T** u_local, const SimParamsMPI& params) {
+    int h = params.halo_depth;
+    int last_row = params.local_rows - 1, last_col = params.local_cols - 1;
+    active_tiles_refresh(active, u_local, 0, h - 1, 0, last_col);
+    active_tiles_refresh(active, u_local, last_row - h + 1, last_row, 0, last_col);
+    active_tiles_refresh(active, u_local, h, last_row - h, 0, h - 1);
+    active_tiles_refresh(active, u_local, h, last_row - h, last_col - h + 1, last_col);
+}
+
+// Updates the interior rows [i_begin, i_end] x columns [j_begin, j_end] while
+// the halo exchange is in flight, in a single thread team. Each thread takes
+// the rows it initialized (heat_owned_rows over the local grid) and sweeps
+// them progress_rows at a time; after each of its chunks the master thread,
+// the only one that calls MPI, tests the exchange to drive its progress.
+template <typename T, typename Acc>
+void compute_interior_overlapped(T** u_old_local, T** u_new_local, const SimParamsMPI& params,
+                                 int i_begin, int i_end, int j_begin, int j_end, ActiveTiles<T>* active) {
+    const int progress_rows = 64; // Rows between MPI_Testall calls to drive progress
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_COMPUTE);
+    double start = params.compute_seconds ? MPI_Wtime() : 0.0;
+    if (!active || active_tiles_plan(*active, u_old_local, u_new_local, i_begin, i_end, j_begin, j_end) > 0) {
+        bool done = false;
+        long points = (long)(i_end - i_begin + 1) * (j_end - j_begin + 1);
+        (void)points;
+        #pragma omp parallel if (points >= HEAT_PARALLEL_MIN_POINTS)
+        {
+            int first, last;
+            heat_owned_rows(params.local_rows, heat_thread_num(), heat_team_size(), first, last);
+            if (first < i_begin) first = i_begin;
+            if (last > i_end) last = i_end;
+            for (int i = first; i <= last; i += progress_rows) {
+                int i_last = i + progress_rows - 1 < last ? i + progress_rows - 1 : last;
+                if (active) {
+                    active_tiles_sweep<T, Acc>(*active, u_old_local, u_new_local, i, i_last, params.coef);
+                } else {
+                    HeatStencil<T, Acc, 1, HEAT_FIXED_WIDTH>::region(u_old_local, u_new_local, i, i_last,
+                                                                     j_begin, j_end, params.coef, params.stream_stores);
+                }
+                if (heat_thread_num() == 0 && !done) done = test_ghost_exchange(params);
+            }
+        }
+        if (active) active_tiles_rescan(*active, u_new_local);
+    }
+    if (params.compute_seconds) *params.compute_seconds += MPI_Wtime() - start;
+}
+
+// Split-phase time step: post the halo exchange of u_old, update the cells that
+// do not touch a halo cell while messages are in flight, then wait and finish
+// the frame along the block edges (reaching `ext` cells into the halo).
+// The interior reads no ghost cell, so with `active` it may be skipped on
+// tile flags the exchange has not refreshed yet.
+template <typename T, typename Acc>
+void perform_overlapped_step(T** u_old_local, T** u_new_local, const SimParamsMPI& params, int ext,
+                             ActiveTiles<T>* active = NULL) {
+    start_ghost_exchange(u_old_local, params);
+
+    int h = params.halo_depth;
+    int ifirst, ilast, jfirst, jlast;
+    get_compute_range(params, ext, ifirst, ilast, jfirst, jlast);
+    int i_in_first = ifirst > h + 1 ? ifirst : h + 1;
+    int i_in_last = ilast < h + params.my_num_rows - 2 ? ilast : h + params.my_num_rows - 2;
+    int j_in_first = jfirst > h + 1 ? jfirst : h + 1;
+    int j_in_last = jlast < h + params.my_num_cols - 2 ? jlast : h + params.my_num_cols - 2;
+
+    if (i_in_first > i_in_last || j_in_first > j_in_last) {
+        // Block too thin to have a halo-independent interior
+        finish_ghost_exchange(params);
+        if (active) refresh_ghost_tiles(*active, u_old_local, params);
+        compute_region<T, Acc>(u_old_local, u_new_local, params, ifirst, ilast, jfirst, jlast, active);
+        return;
+    }
+
+    compute_interior_overlapped<T, Acc>(u_old_local, u_new_local, params, i_in_first, i_in_last,
+                                        j_in_first, j_in_last, active);
+    finish_ghost_exchange(params); // Also the on-node copies, which never overlap
+    if (active) refresh_ghost_tiles(*active, u_old_local, params);
+
+    compute_region<T, Acc>(u_old_local, u_new_local, params, ifirst, i_in_first - 1, jfirst, jlast, active);
+    compute_region<T, Acc>(u_old_local, u_new_local, params, i_in_last + 1, ilast, jfirst, jlast, active);
+    compute_region<T, Acc>(u_old_local, u_new_local, params, i_in_first, i_in_last, jfirst, j_in_first - 1, active);
+    compute_region<T, Acc>(u_old_local, u_new_local, params, i_in_first, i_in_last, j_in_last + 1, jlast, active);
+}
+
+// This rank's block within the global row-major grid (file view for MPI-IO).
+MPI_Datatype create_block_file_type(const SimParamsMPI& params) {
+    int global_sizes[2] = {params.N_total_pts, params.N_total_pts};
+    int block_sizes[2] = {params.my_num_rows, params.my_num_cols};
+    int global_starts[2] = {params.my_start_row_global, params.my_start_col_global};
+    MPI_Datatype file_type;
+    MPI_Type_create_subarray(2, global_sizes, block_sizes, global_starts, MPI_ORDER_C, params.scalar_type, &file_type);
+    MPI_Type_commit(&file_type);
+    return file_type;
+}
+
+// This rank's block within the local array, i.e. without the halo.
+MPI_Datatype create_block_memory_type(const SimParamsMPI& params) {
+    int local_sizes[2] = {params.local_rows, params.row_stride};
+    int block_sizes[2] = {params.my_num_rows, params.my_num_cols};
+    int local_starts[2] = {params.halo_depth, params.halo_depth};
+    MPI_Datatype block_type;
+    MPI_Type_create_subarray(2, local_sizes, block_sizes, local_starts, MPI_ORDER_C, params.scalar_type, &block_type);
+    MPI_Type_commit(&block_type);
+    return block_type;
+}
+
+// Asynchronous checkpoint writer. A checkpoint copies the local block into a
+// staging buffer and starts a non-blocking collective write
+// (MPI_File_iwrite_at_all) to "<file>.tmp", so the time loop keeps computing
+// while it drains. The write is completed before the next checkpoint starts
+// (or at the end of the run); rank 0 then renames the file into place, so the
+// previous checkpoint is only ever replaced by a complete one.
+struct CheckpointWriter {
+    bool pending;
+    MPI_File fh;
+    MPI_Request request;
+    std::vector<char> staging; // my_num_rows x my_num_cols values of elem_size bytes
+    int iteration;
+};
+
+void finish_checkpoint(CheckpointWriter& writer, const SimParamsMPI& params) {
+    if (!writer.pending) return;
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_CHECKPOINT);
+    MPI_Wait(&writer.request, MPI_STATUS_IGNORE);
+    MPI_File_close(&writer.fh);
+    writer.pending = false;
+    if (params.rank == 0) {
+        std::string tmp_name = std::string(params.checkpoint_file) + ".tmp";
+        if (rename(tmp_name.c_str(), params.checkpoint_file) != 0) {
+            fprintf(stderr, "Rank 0: Error moving checkpoint %s into place.\n", tmp_name.c_str());
+        } else {
+            printf("Rank 0: Checkpoint at iteration %d written to %s\n", writer.iteration, params.checkpoint_file);
+        }
+    }
+}
+
+template <typename T>
+void start_checkpoint(CheckpointWriter& writer, T** u_local, const SimParamsMPI& params, int iteration) {
+    finish_checkpoint(writer, params);
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_CHECKPOINT);
+
+    std::string tmp_name = std::string(params.checkpoint_file) + ".tmp";
+    if (MPI_File_open(params.cart_comm, tmp_name.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &writer.fh) != MPI_SUCCESS) {
+        if (params.rank == 0) fprintf(stderr, "Rank 0: Error opening checkpoint %s for writing.\n", tmp_name.c_str());
+        return;
+    }
+
+    HeatCheckpointHeader header;
+    memcpy(header.magic, HEAT_CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = HEAT_CHECKPOINT_VERSION;
+    header.elem_size = sizeof(T);
+    header.rows = header.cols = (uint64_t)params.N_total_pts;
+    header.iteration = iteration;
+    header.n_global = params.n_global;
+    header.max_iterations = params.max_iterations;
+    header.c_const = params.c_const;
+    header.boundary_top = params.boundary_top;
+    header.boundary_bottom = params.boundary_bottom;
+    header.boundary_left = params.boundary_left;
+    header.boundary_right = params.boundary_right;
+    header.dt = params.dt;
+    header.scheme = params.adi ? HEAT_SCHEME_ADI : HEAT_SCHEME_EXPLICIT;
+    header.precision = params.precision;
+
+    MPI_Offset data_offset = sizeof(header);
+    MPI_File_set_size(writer.fh, data_offset + (MPI_Offset)params.N_total_pts * params.N_total_pts * sizeof(T));
+    if (params.rank == 0) {
+        MPI_File_write_at(writer.fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    // Stage the block so the solver can keep overwriting the grid during the write
+    size_t row_bytes = params.my_num_cols * sizeof(T);
+    writer.staging.resize(params.my_num_rows * row_bytes);
+    for (int i = 0; i < params.my_num_rows; ++i) {
+        memcpy(&writer.staging[i * row_bytes], &u_local[i + params.halo_depth][params.halo_depth], row_bytes);
+    }
+
+    MPI_Datatype file_type = create_block_file_type(params);
+    MPI_File_set_view(writer.fh, data_offset, params.scalar_type, file_type, "native", MPI_INFO_NULL);
+    MPI_Type_free(&file_type);
+    MPI_File_iwrite_at_all(writer.fh, 0, writer.staging.data(), params.my_num_rows * params.my_num_cols,
+                           params.scalar_type, &writer.request);
+    writer.pending = true;
+    writer.iteration = iteration;
+}
+
+// Snapshot stream of a run (--snapshot-every, heat_snapshot.h). Each file is
+// written as "<name>.tmp". Once a rank's I/O thread has finished its part,
+// the rank joins a non-blocking MIN reduction of the write outcomes; when that
+// completes, rank 0 renames the file into place and, with --snapshot-keep N,
+// deletes the oldest snapshot beyond N. The reductions run on a duplicate of
+// cart_comm, so ranks may start them at different points of the time loop.
+struct SnapshotCompletion {
+    int iteration;
+    int ok;               // This rank's part was written
+    int all_ok;           // Every rank's part was written
+    MPI_Request request;
+};
+
+struct SnapshotStream {
+    SnapshotWriter writer;
+    MPI_Comm comm;                              // Duplicate of cart_comm for the reductions
+    std::deque<SnapshotCompletion> completions; // Reductions in flight, oldest first
+    std::deque<int> kept;                       // Rank 0: snapshots on disk, oldest first
+    int written;                                // Rank 0: snapshots moved into place
+    int failed;
+    double loop_seconds;                        // Spent on the time loop (staging and waiting)
+};
+
+std::string snapshot_path(const SimParamsMPI& params, int iteration) {
+    char name[32];
+    snprintf(name, sizeof(name), "%08d.bin", iteration);
+    return std::string(params.snapshot_prefix) + name;
+}
+
+bool snapshot_due(const SimParamsMPI& params, int before, int after) {
+    return params.snapshot_every > 0 && after / params.snapshot_every != before / params.snapshot_every;
+}
+
+void start_snapshots(SnapshotStream& stream, const SimParamsMPI& params) {
+    MPI_Comm_dup(params.cart_comm, &stream.comm);
+    stream.written = stream.failed = 0;
+    stream.loop_seconds = 0.0;
+    snapshot_writer_start(stream.writer);
+}
+
+// Joins the reduction of every snapshot this rank has finished writing, and
+// completes the reductions that are done, in order (all of them if `wait`).
+void progress_snapshots(SnapshotStream& stream, const SimParamsMPI& params, bool wait) {
+    int iteration;
+    bool ok;
+    while (snapshot_collect(stream.writer, iteration, ok)) {
+        stream.completions.push_back(SnapshotCompletion()); // deque: earlier buffers stay in place
+        SnapshotCompletion& c = stream.completions.back();
+        c.iteration = iteration;
+        c.ok = ok ? 1 : 0;
+        c.all_ok = 0;
+        MPI_Iallreduce(&c.ok, &c.all_ok, 1, MPI_INT, MPI_MIN, stream.comm, &c.request);
+    }
+    while (!stream.completions.empty()) {
+        SnapshotCompletion& c = stream.completions.front();
+        int done = 1;
+        if (wait) {
+            MPI_Wait(&c.request, MPI_STATUS_IGNORE);
+        } else {
+            MPI_Test(&c.request, &done, MPI_STATUS_IGNORE);
+        }
+        if (!done) break;
+        if (params.rank == 0) {
+            std::string path = snapshot_path(params, c.iteration);
+            std::string tmp_path = path + ".tmp";
+            if (c.all_ok && rename(tmp_path.c_str(), path.c_str()) == 0) {
+                stream.written++;
+                stream.kept.push_back(c.iteration);
+                if (params.snapshot_keep > 0 && (int)stream.kept.size() > params.snapshot_keep) {
+                    remove(snapshot_path(params, stream.kept.front()).c_str());
+                    stream.kept.pop_front();
+                }
+            } else {
+                fprintf(stderr, "Rank 0: Error writing snapshot %s.\n", path.c_str());
+                remove(tmp_path.c_str());
+                stream.failed++;
+            }
+        }
+        stream.completions.pop_front();
+    }
+}
+
+// Stages this rank's part of the snapshot at `iteration` and queues it for
+// the I/O thread. Only waits if the slot is still held by the snapshot before
+// the previous one.
+template <typename T>
+void take_snapshot(SnapshotStream& stream, T** u_local, const SimParamsMPI& params, int iteration) {
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_SNAPSHOT);
+    double start = MPI_Wtime();
+    SnapshotSlot& slot = snapshot_wait_slot(stream.writer);
+    progress_snapshots(stream, params, false); // Collects the slot's previous snapshot
+
+    const SnapshotLayout& layout = params.snapshot;
+    slot.iteration = iteration;
+    slot.path = snapshot_path(params, iteration) + ".tmp";
+    slot.elem_size = sizeof(T);
+    slot.rows = layout.rows;
+    slot.cols = layout.cols;
+    slot.write_header = params.rank == 0;
+    snapshot_owned_range(layout.row0, layout.stride, layout.rows, params.my_start_row_global,
+                         params.my_start_row_global + params.my_num_rows, slot.first_row, slot.row_count);
+    snapshot_owned_range(layout.col0, layout.stride, layout.cols, params.my_start_col_global,
+                         params.my_start_col_global + params.my_num_cols, slot.first_col, slot.col_count);
+    slot.data.resize((size_t)slot.row_count * slot.col_count * sizeof(T));
+    T* out = (T*)slot.data.data();
+    int h = params.halo_depth;
+    for (int a = 0; a < slot.row_count; ++a) {
+        int i_global = layout.row0 + (slot.first_row + a) * layout.stride;
+        const T* row = u_local[h + i_global - params.my_start_row_global] + h - params.my_start_col_global;
+        for (int b = 0; b < slot.col_count; ++b) {
+            *out++ = row[layout.col0 + (slot.first_col + b) * layout.stride];
+        }
+    }
+    snapshot_submit(stream.writer, slot);
+    stream.loop_seconds += MPI_Wtime() - start;
+}
+
+// Writes the queued snapshots, waits until every file is in place and
+// reports the cost on rank 0.
+void finish_snapshots(SnapshotStream& stream, const SimParamsMPI& params) {
+    {
+        HEAT_PROFILE_SCOPE(HEAT_PHASE_SNAPSHOT);
+        double start = MPI_Wtime();
+        snapshot_writer_stop(stream.writer);
+        progress_snapshots(stream, params, true);
+        stream.loop_seconds += MPI_Wtime() - start;
+    }
+    double local[2] = {stream.loop_seconds, stream.writer.write_seconds}, slowest[2];
+    MPI_Reduce(local, slowest, 2, MPI_DOUBLE, MPI_MAX, 0, stream.comm);
+    if (params.rank == 0) {
+        printf("Rank 0: %d snapshots (%dx%d) written to %s*.bin", stream.written, params.snapshot.rows,
+               params.snapshot.cols, params.snapshot_prefix);
+        if (stream.failed > 0) printf(", %d failed", stream.failed);
+        printf("; time loop %.6f s, I/O thread %.6f s (max over ranks).\n", slowest[0], slowest[1]);
+    }
+    MPI_Comm_free(&stream.comm);
+}
+
+// Owned cells [row0, row0 + rows) x [col0, col0 + cols) (global indices) as a
+// subarray of a local array laid out as described by `params`.
+MPI_Datatype create_local_subarray_type(const SimParamsMPI& params, int row0, int col0, int rows, int cols) {
+    int local_sizes[2] = {params.local_rows, params.row_stride};
+    int sub_sizes[2] = {rows, cols};
+    int local_starts[2] = {params.halo_depth + row0 - params.my_start_row_global,
+                           params.halo_depth + col0 - params.my_start_col_global};
+    MPI_Datatype sub_type;
+    MPI_Type_create_subarray(2, local_sizes, sub_sizes, local_starts, MPI_ORDER_C, params.scalar_type, &sub_type);
+    MPI_Type_commit(&sub_type);
+    return sub_type;
+}
+
+// Intersection [lo, hi) of [a0, a1) and [b0, b1); false if it is empty.
+bool range_overlap(int a0, int a1, int b0, int b1, int& lo, int& hi) {
+    lo = a0 > b0 ? a0 : b0;
+    hi = a1 < b1 ? a1 : b1;
+    return lo < hi;
+}
+
+// New block starts for one dimension of the process grid. seconds[p] is the
+// compute time block p took over the last window (the slowest rank of its
+// process row or column). Blocks get computed points in proportion to their
+// measured speed, and at least min_count each. The starts come back unchanged
+// while the slowest block is within `tolerance` of the mean, so measurement
+// noise does not move data back and forth.
+std::vector<int> rebalanced_starts(const std::vector<int>& starts, const std::vector<double>& seconds,
+                                   int min_count, double tolerance) {
+    int parts = (int)starts.size() - 1;
+    int n_global = starts[parts] - 2;
+    double mean = 0.0, slowest = 0.0;
+    for (int p = 0; p < parts; ++p) {
+        if (seconds[p] <= 0.0) return starts; // Nothing measured
+        mean += seconds[p] / parts;
+        if (seconds[p] > slowest) slowest = seconds[p];
+    }
+    if (parts < 2 || parts * min_count > n_global || slowest <= (1.0 + tolerance) * mean) return starts;
+
+    std::vector<double> share(parts);
+    double total_speed = 0.0;
+    for (int p = 0; p < parts; ++p) {
+        int computed = starts[p + 1] - starts[p] - (p == 0 ? 1 : 0) - (p == parts - 1 ? 1 : 0);
+        share[p] = computed / seconds[p];
+        total_speed += share[p];
+    }
+    // Largest-remainder rounding of n_global * speed / total_speed
+    std::vector<int> counts(parts);
+    int assigned = 0;
+    for (int p = 0; p < parts; ++p) {
+        share[p] *= n_global / total_speed;
+        counts[p] = (int)share[p];
+        share[p] -= counts[p];
+        if (counts[p] < min_count) {
+            counts[p] = min_count;
+            share[p] = -1.0;
+        }
+        assigned += counts[p];
+    }
+    while (assigned < n_global) {
+        int best = 0;
+        for (int p = 1; p < parts; ++p) {
+            if (share[p] > share[best]) best = p;
+        }
+        counts[best]++;
+        share[best] -= 1.0;
+        assigned++;
+    }
+    while (assigned > n_global) {
+        int largest = 0;
+        for (int p = 1; p < parts; ++p) {
+            if (counts[p] > counts[largest]) largest = p;
+        }
+        counts[largest]--;
+        assigned--;
+    }
+
+    std::vector<int> result(parts + 1);
+    result[0] = 0;
+    for (int p = 1, next = 1; p < parts; ++p) {
+        next += counts[p - 1];
+        result[p] = next;
+    }
+    result[parts] = n_global + 2;
+    return result;
+}
+
+// Copies the owned blocks of `from`, laid out as in old_params, into `to`,
+// laid out as in params. One MPI_Alltoallw over subarray types; after a
+// rebalance only neighboring blocks overlap, so only they exchange data.
+template <typename T>
+void redistribute_blocks(T** from, const SimParamsMPI& old_params, T** to, const SimParamsMPI& params) {
+    int size = params.size;
+    std::vector<int> send_counts(size, 0), recv_counts(size, 0), displs(size, 0);
+    std::vector<MPI_Datatype> send_types(size, params.scalar_type), recv_types(size, params.scalar_type);
+    for (int q = 0; q < size; ++q) {
+        int qc[2], r0, r1, c0, c1;
+        MPI_Cart_coords(params.cart_comm, q, 2, qc);
+        // Cells this rank owned that q owns now
+        if (range_overlap(old_params.my_start_row_global, old_params.my_start_row_global + old_params.my_num_rows,
+                          params.row_starts[qc[0]], params.row_starts[qc[0] + 1], r0, r1) &&
+            range_overlap(old_params.my_start_col_global, old_params.my_start_col_global + old_params.my_num_cols,
+                          params.col_starts[qc[1]], params.col_starts[qc[1] + 1], c0, c1)) {
+            send_types[q] = create_local_subarray_type(old_params, r0, c0, r1 - r0, c1 - c0);
+            send_counts[q] = 1;
+        }
+        // Cells this rank owns now that q owned
+        if (range_overlap(params.my_start_row_global, params.my_start_row_global + params.my_num_rows,
+                          old_params.row_starts[qc[0]], old_params.row_starts[qc[0] + 1], r0, r1) &&
+            range_overlap(params.my_start_col_global, params.my_start_col_global + params.my_num_cols,
+                          old_params.col_starts[qc[1]], old_params.col_starts[qc[1] + 1], c0, c1)) {
+            recv_types[q] = create_local_subarray_type(params, r0, c0, r1 - r0, c1 - c0);
+            recv_counts[q] = 1;
+        }
+    }
+    MPI_Alltoallw(from[0], send_counts.data(), displs.data(), send_types.data(),
+                  to[0], recv_counts.data(), displs.data(), recv_types.data(), params.cart_comm);
+    for (int q = 0; q < size; ++q) {
+        if (send_counts[q]) MPI_Type_free(&send_types[q]);
+        if (recv_counts[q]) MPI_Type_free(&recv_types[q]);
+    }
+}
+
+// One adaptive load-balancing step (--rebalance). Every rank's compute time
+// over the last window is gathered, and each process row and column is
+// sized by the speed of its slowest rank (rebalanced_starts). If the
+// decomposition changes, the local grids are rebuilt for the new layout and
+// the current time level is moved into them; grids keeps pointing at the
+// same time levels. All ranks take the same decision from the same data.
+template <typename T>
+void rebalance_decomposition(DoubleBuffer<T>& grids, LocalGrids<T>& local, SimParamsMPI& params, double seconds) {
+    const double tolerance = 0.05; // Tolerated max / mean compute time - 1
+    std::vector<double> all_seconds(params.size);
+    MPI_Allgather(&seconds, 1, MPI_DOUBLE, all_seconds.data(), 1, MPI_DOUBLE, params.cart_comm);
+    std::vector<double> row_seconds(params.dims[0], 0.0), col_seconds(params.dims[1], 0.0);
+    for (int q = 0; q < params.size; ++q) {
+        int qc[2];
+        MPI_Cart_coords(params.cart_comm, q, 2, qc);
+        if (all_seconds[q] > row_seconds[qc[0]]) row_seconds[qc[0]] = all_seconds[q];
+        if (all_seconds[q] > col_seconds[qc[1]]) col_seconds[qc[1]] = all_seconds[q];
+    }
+    std::vector<int> rows = rebalanced_starts(params.row_starts, row_seconds, params.halo_depth, tolerance);
+    std::vector<int> cols = rebalanced_starts(params.col_starts, col_seconds, params.halo_depth, tolerance);
+    if (rows == params.row_starts && cols == params.col_starts) return;
+
+    SimParamsMPI old_params = params;
+    int current = grids.current == local.grid[0].data() ? 0 : 1; // Same on every rank (lockstep swaps)
+    LocalGrids<T> old_local = std::move(local);
+    params.row_starts = rows;
+    params.col_starts = cols;
+    apply_decomposition(params, true);
+    create_local_grids(local, params);
+    initialize_local_grid(local.grid[0].data(), local.grid[1].data(), params); // Boundary cells in both levels
+    redistribute_blocks(grids.current, old_params, local.grid[current].data(), params);
+    free_halo_plan(old_local.plan);
+    grids.current = local.grid[current].data();
+    grids.next = local.grid[1 - current].data();
+
+    if (params.rank == 0) {
+        double mean = 0.0, slowest = 0.0;
+        for (int q = 0; q < params.size; ++q) {
+            mean += all_seconds[q] / params.size;
+            if (all_seconds[q] > slowest) slowest = all_seconds[q];
+        }
+        printf("Rank 0: Rebalanced blocks (slowest/mean compute time was %.2f); rows per block:", slowest / mean);
+        for (int p = 0; p < params.dims[0]; ++p) printf(" %d", rows[p + 1] - rows[p]);
+        printf(", columns per block:");
+        for (int p = 0; p < params.dims[1]; ++p) printf(" %d", cols[p + 1] - cols[p]);
+        printf("\n");
+    }
+}
+
+// Whether a checkpoint is due after advancing from iteration `before` to
+// `after`. The wall-clock trigger needs agreement between ranks, so it is only
+// evaluated (with one small allreduce) every 64 iterations.
+bool checkpoint_due(const SimParamsMPI& params, int before, int after, double last_checkpoint_time) {
+    const int time_poll_iterations = 64;
+    if (!params.checkpoint_file || after >= params.max_iterations) return false;
+    if (params.checkpoint_every > 0 && after / params.checkpoint_every != before / params.checkpoint_every) {
+        return true;
+    }
+    if (params.checkpoint_seconds > 0.0 && after / time_poll_iterations != before / time_poll_iterations) {
+        int local_due = MPI_Wtime() - last_checkpoint_time >= params.checkpoint_seconds ? 1 : 0, due = 0;
+        MPI_Allreduce(&local_due, &due, 1, MPI_INT, MPI_MAX, params.cart_comm);
+        return due != 0;
+    }
+    return false;
+}
+
+// Reads the checkpoint header on rank 0 and broadcasts it. The grid size, heat
+// constant, boundaries, time step and scheme of the run are taken from the
+// checkpoint, as is max_iterations unless it was given on the command line.
+// An n_global, --precision, --dt or --adi that contradicts the checkpoint is
+// an error.
+void read_checkpoint_parameters(SimParamsMPI& params) {
+    HeatCheckpointHeader header;
+    int ok = 0;
+    if (params.rank == 0) {
+        FILE* file = fopen(params.restart_file, "rb");
+        if (file) {
+            ok = fread(&header, sizeof(header), 1, file) == 1 && checkpoint_header_valid(header);
+            fclose(file);
+        }
+        if (!ok) fprintf(stderr, "Rank 0: %s is not a readable checkpoint.\n", params.restart_file);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ok) {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (params.n_global > 0 && params.n_global != header.n_global) {
+        if (params.rank == 0) {
+            fprintf(stderr, "Rank 0: %s holds a %d-point grid, not %d; omit n_global or match it.\n",
+                    params.restart_file, header.n_global, params.n_global);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (header.precision != params.precision) {
+        if (params.rank == 0) {
+            fprintf(stderr, "Rank 0: %s was written with --precision %s; restart with a matching --precision.\n",
+                    params.restart_file, heat_precision_name((HeatPrecision)header.precision));
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if ((params.dt_request > 0.0 && params.dt_request != header.dt) ||
+        (params.adi && header.scheme != HEAT_SCHEME_ADI)) {
+        if (params.rank == 0) {
+            fprintf(stderr, "Rank 0: %s was written by an %s run with dt %g; drop --dt/--adi or match them.\n",
+                    params.restart_file, header.scheme == HEAT_SCHEME_ADI ? "ADI" : "explicit", header.dt);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    params.n_global = header.n_global;
+    params.c_const = header.c_const;
+    params.boundary_top = header.boundary_top;
+    params.boundary_bottom = header.boundary_bottom;
+    params.boundary_left = header.boundary_left;
+    params.boundary_right = header.boundary_right;
+    params.dt_request = header.dt;
+    params.adi = header.scheme == HEAT_SCHEME_ADI;
+    params.start_iteration = (int)header.iteration;
+    if (params.max_iterations < 0) params.max_iterations = header.max_iterations;
+}
+
+// Loads this rank's block of the checkpointed grid, whatever decomposition
+// wrote it, into the owned part of u_local.
+template <typename T>
+void read_checkpoint_grid(T** u_local, const SimParamsMPI& params) {
+    MPI_File fh;
+    if (MPI_File_open(params.cart_comm, params.restart_file, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (params.rank == 0) fprintf(stderr, "Rank 0: Error opening checkpoint %s.\n", params.restart_file);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Datatype file_type = create_block_file_type(params);
+    MPI_Datatype block_type = create_block_memory_type(params);
+    MPI_File_set_view(fh, sizeof(HeatCheckpointHeader), params.scalar_type, file_type, "native", MPI_INFO_NULL);
+    int err = MPI_File_read_at_all(fh, 0, u_local[0], 1, block_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    MPI_Type_free(&file_type);
+    MPI_Type_free(&block_type);
+    if (err != MPI_SUCCESS) {
+        fprintf(stderr, "Rank %d: Error reading checkpoint %s.\n", params.rank, params.restart_file);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+// Each step reads grids.current and writes grids.next, then the two are swapped,
+// so grids.current always holds the latest state.
+// With halo_depth k the halo is exchanged every k steps. The step right after an
+// exchange updates the block plus k-1 halo cells, the next one k-2, and so on,
+// so each step only reads cells the previous one left valid. Every cell is
+// computed from the same inputs as with k = 1, so results are bit-identical.
+// The k-1 steps between exchanges need no communication and run through the
+// cache-tiled engine unless tiling is disabled (--tile-steps 1).
+// Runs resume at params.start_iteration and checkpoint at block boundaries.
+// With --rebalance the decomposition (params and local) may change at block
+// boundaries once per measurement window.
+// Until the front fills the block, steps go one at a time through the active
+// tiles (heat_active.h); in a fresh run, exchanges with blocks the front
+// cannot have reached yet are skipped (halo_pair_idle).
+template <typename T, typename Acc>
+void run_mpi_simulation(DoubleBuffer<T>& grids, LocalGrids<T>& local, SimParamsMPI& params) {
+    int h = params.halo_depth;
+    ActiveTiles<T> active;
+    bool tracking = params.active_tracking &&
+                    active_tiles_init<T, Acc>(active, grids.current, grids.next, params.local_rows, params.local_cols,
+                                              params.initial_value, params.coef);
+    // Untouched blocks are only known for the uniform start; every rank decides alike
+    bool skip_idle = params.active_tracking && !params.restart_file && params.start_iteration == 0 &&
+                     active_value_is_fixed<T, Acc>((T)params.initial_value, params.coef);
+    const double saturation = h > 1 && params.tiling.time_steps > 1 ? HEAT_ACTIVE_SATURATION_TILED : HEAT_ACTIVE_SATURATION;
+    CheckpointWriter checkpoint;
+    checkpoint.pending = false;
+    double last_checkpoint_time = MPI_Wtime();
+    double compute_seconds = 0.0;
+    int next_rebalance = params.start_iteration + params.rebalance_every;
+    if (params.rebalance_every > 0) params.compute_seconds = &compute_seconds;
+    SnapshotStream snapshots;
+    if (params.snapshot_every > 0) {
+        start_snapshots(snapshots, params);
+        if (params.start_iteration % params.snapshot_every == 0) {
+            take_snapshot(snapshots, grids.current, params, params.start_iteration);
+        }
+    }
+
+    for (int iter = params.start_iteration; iter < params.max_iterations; iter += h) {
+        // Steps until the next exchange (or the end of the run)
+        int steps = params.max_iterations - iter < h ? params.max_iterations - iter : h;
+
+        local.plan.front = skip_idle ? iter : -1;
+        perform_overlapped_step<T, Acc>(grids.current, grids.next, params, steps - 1, tracking ? &active : NULL);
+        grids.swap();
+
+        if (tracking) {
+            for (int s = 1; s < steps; ++s) {
+                perform_computation_step<T, Acc>(grids.current, grids.next, params, steps - 1 - s, &active);
+                grids.swap();
+            }
+            if (active_tiles_saturated(active, saturation)) tracking = false;
+        } else if (steps > 1 && params.tiling.time_steps > 1) {
+            HEAT_PROFILE_SCOPE(HEAT_PHASE_COMPUTE_TILED);
+            double start = MPI_Wtime();
+            stencil_advance_tiled<T, Acc>(grids.current, grids.next, steps - 1, params.coef, params.tiling,
+                                  [&params, steps](int s, int& i0, int& i1, int& j0, int& j1) {
+                                      get_compute_range(params, steps - 2 - s, i0, i1, j0, j1);
+                                  });
+            compute_seconds += MPI_Wtime() - start;
+            if ((steps - 1) % 2 != 0) grids.swap();
+        } else {
+            for (int s = 1; s < steps; ++s) {
+                perform_computation_step<T, Acc>(grids.current, grids.next, params, steps - 1 - s);
+                grids.swap();
+            }
+        }
+
+        if (params.rebalance_every > 0 && iter + steps >= next_rebalance && iter + steps < params.max_iterations) {
+            rebalance_decomposition(grids, local, params, compute_seconds);
+            compute_seconds = 0.0;
+            if (tracking) {
+                active_tiles_init<T, Acc>(active, grids.current, grids.next, params.local_rows, params.local_cols,
+                                          params.initial_value, params.coef);
+            }
+            next_rebalance = iter + steps + params.rebalance_every;
+        }
+
+        if (snapshot_due(params, iter, iter + steps)) {
+            take_snapshot(snapshots, grids.current, params, iter + steps);
+        }
+        if (checkpoint_due(params, iter, iter + steps, last_checkpoint_time)) {
+            start_checkpoint(checkpoint, grids.current, params, iter + steps);
+            last_checkpoint_time = MPI_Wtime();
+        }
+    }
+    finish_checkpoint(checkpoint, params);
+    if (params.snapshot_every > 0) finish_snapshots(snapshots, params);
+    params.compute_seconds = NULL;
+    local.plan.front = -1;
+}
+
+template <typename T> MPI_Datatype heat_mpi_type();
+template <> MPI_Datatype heat_mpi_type<double>() { return MPI_DOUBLE; }
+template <> MPI_Datatype heat_mpi_type<float>() { return MPI_FLOAT; }
+
+// One ADI half step (heat_adi.h), implicit along rows (along_rows) or columns.
+// A grid line crosses every block of its process row (column), so the lines
+// are transposed: each rank computes the right-hand side of its block, the
+// blocks are redistributed with one MPI_Alltoallv so that every rank holds
+// complete lines for an even share (block_decompose) of the lines, those are
+// solved with adi_solve_line, and a second MPI_Alltoallv sends the solved
+// segments back into dst. Right-hand sides travel in Acc, so every line is
+// solved from exactly the values the serial solver uses. Cells on the global
+// boundary are sent as they are and come back unchanged. src needs valid
+// ghost cells across the explicit direction.
+template <typename T, typename Acc>
+void adi_half_step(T** src, T** dst, const SimParamsMPI& params, const AdiFactors<Acc>& factors, bool along_rows) {
+    const int h = params.halo_depth;
+    const int N = params.N_total_pts;
+    MPI_Comm comm = along_rows ? params.row_comm : params.col_comm;
+    const int parts = params.dims[along_rows ? 1 : 0];
+    const int me = params.coords[along_rows ? 1 : 0];
+    const int num_lines = along_rows ? params.my_num_rows : params.my_num_cols;  // Lines through my block
+    const int segment = along_rows ? params.my_num_cols : params.my_num_rows;    // My part of each line
+    const int line_base = along_rows ? params.my_start_row_global : params.my_start_col_global;
+    const int seg_base = along_rows ? params.my_start_col_global : params.my_start_row_global;
+    const std::vector<int>& seg_starts = along_rows ? params.col_starts : params.row_starts; // Blocks along a line
+
+    std::vector<int> send_counts(parts), send_displs(parts), recv_counts(parts), recv_displs(parts);
+    int my_first, my_count;
+    block_decompose(num_lines, parts, me, my_first, my_count);
+    for (int q = 0, sent = 0, received = 0; q < parts; ++q) {
+        int first, count;
+        block_decompose(num_lines, parts, q, first, count);
+        int seg_count = seg_starts[q + 1] - seg_starts[q];
+        send_counts[q] = count * segment;
+        send_displs[q] = sent;
+        recv_counts[q] = my_count * seg_count;
+        recv_displs[q] = received;
+        sent += send_counts[q];
+        received += recv_counts[q];
+    }
+    std::vector<Acc> send((size_t)num_lines * segment);
+    std::vector<Acc> lines((size_t)my_count * N);
+    std::vector<Acc> recv(lines.size());
+
+    // Right-hand sides, packed by destination (line-major, as lines ascend)
+    {
+        HEAT_PROFILE_SCOPE(HEAT_PHASE_COMPUTE);
+        #pragma omp parallel for schedule(static)
+        for (int k = 0; k < num_lines; ++k) {
+            Acc* out = &send[(size_t)k * segment];
+            bool line_inner = line_base + k >= 1 && line_base + k <= N - 2;
+            for (int p = 0; p < segment; ++p) {
+                int i = along_rows ? h + k : h + p;
+                int j = along_rows ? h + p : h + k;
+                if (!line_inner || seg_base + p < 1 || seg_base + p > N - 2) {
+                    out[p] = (Acc)src[i][j];
+                } else if (along_rows) {
+                    out[p] = adi_rhs<T, Acc>(factors, src[i][j], src[i - 1][j], src[i + 1][j]);
+                } else {
+                    out[p] = adi_rhs<T, Acc>(factors, src[i][j], src[i][j - 1], src[i][j + 1]);
+                }
+            }
+        }
+    }
+    {
+        HEAT_PROFILE_SCOPE(HEAT_PHASE_ADI_TRANSPOSE);
+        MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(), heat_mpi_type<Acc>(),
+                      recv.data(), recv_counts.data(), recv_displs.data(), heat_mpi_type<Acc>(), comm);
+    }
+
+    {
+        HEAT_PROFILE_SCOPE(HEAT_PHASE_ADI_SOLVE);
+        #pragma omp parallel for schedule(static)
+        for (int l = 0; l < my_count; ++l) {
+            Acc* line = &lines[(size_t)l * N];
+            for (int q = 0; q < parts; ++q) {
+                int seg_start = seg_starts[q], seg_count = seg_starts[q + 1] - seg_starts[q];
+                memcpy(line + seg_start, &recv[recv_displs[q] + (size_t)l * seg_count], seg_count * sizeof(Acc));
+            }
+            int global_line = line_base + my_first + l;
+            if (global_line >= 1 && global_line <= N - 2) adi_solve_line(line, factors);
+            for (int q = 0; q < parts; ++q) {
+                int seg_start = seg_starts[q], seg_count = seg_starts[q + 1] - seg_starts[q];
+                memcpy(&recv[recv_displs[q] + (size_t)l * seg_count], line + seg_start, seg_count * sizeof(Acc));
+            }
+        }
+    }
+    {
+        HEAT_PROFILE_SCOPE(HEAT_PHASE_ADI_TRANSPOSE);
+        MPI_Alltoallv(recv.data(), recv_counts.data(), recv_displs.data(), heat_mpi_type<Acc>(),
+                      send.data(), send_counts.data(), send_displs.data(), heat_mpi_type<Acc>(), comm);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int k = 0; k < num_lines; ++k) {
+        const Acc* in = &send[(size_t)k * segment];
+        for (int p = 0; p < segment; ++p) {
+            if (along_rows) {
+                dst[h + k][h + p] = (T)in[p];
+            } else {
+                dst[h + p][h + k] = (T)in[p];
+            }
+        }
+    }
+}
+
+// ADI steps (--adi): the row half step writes grids.next from grids.current,
+// the column half step writes the new state back into grids.current, so there
+// is no swap. Each half step needs the halo across its explicit direction.
+// Checkpoints work as in run_mpi_simulation.
+template <typename T, typename Acc>
+void run_mpi_adi_simulation(DoubleBuffer<T>& grids, const SimParamsMPI& params) {
+    const AdiFactors<Acc> factors = adi_make_factors<Acc>(params.n_global, params.coef);
+    CheckpointWriter checkpoint;
+    checkpoint.pending = false;
+    double last_checkpoint_time = MPI_Wtime();
+    SnapshotStream snapshots;
+    if (params.snapshot_every > 0) {
+        start_snapshots(snapshots, params);
+        if (params.start_iteration % params.snapshot_every == 0) {
+            take_snapshot(snapshots, grids.current, params, params.start_iteration);
+        }
+    }
+
+    for (int iter = params.start_iteration; iter < params.max_iterations; ++iter) {
+        exchange_ghost_rows(grids.current, params);
+        adi_half_step<T, Acc>(grids.current, grids.next, params, factors, true);
+        exchange_ghost_rows(grids.next, params);
+        adi_half_step<T, Acc>(grids.next, grids.current, params, factors, false);
+
+        if (snapshot_due(params, iter, iter + 1)) {
+            take_snapshot(snapshots, grids.current, params, iter + 1);
+        }
+        if (checkpoint_due(params, iter, iter + 1, last_checkpoint_time)) {
+            start_checkpoint(checkpoint, grids.current, params, iter + 1);
+            last_checkpoint_time = MPI_Wtime();
+        }
+    }
+    finish_checkpoint(checkpoint, params);
+    if (params.snapshot_every > 0) finish_snapshots(snapshots, params);
+}
+
+// Relaxes the local grid in place with red-black SOR, exchanging halos before
+// each color. Every check_every-th sweep the local largest correction is
+// combined with a non-blocking MPI_Iallreduce that completes in the
+// background; its result is only awaited at the next check, so convergence is
+// detected up to check_every sweeps late but sweeps never stall on it.
+template <typename T, typename Acc>
+SteadyResult run_mpi_steady_simulation(T** u_local, const SimParamsMPI& params) {
+    int h = params.halo_depth;
+    int parity = (params.my_start_row_global - h) + (params.my_start_col_global - h);
+    SteadyResult result = {0, 0.0, false};
+    MPI_Request reduce_req = MPI_REQUEST_NULL;
+    double local_residual = 0.0, global_residual = 0.0;
+
+    for (int sweep = 1; sweep <= params.max_iterations; ++sweep) {
+        bool check = sweep % params.check_every == 0;
+        double residual = 0.0;
+        for (int color = 0; color < 2; ++color) {
+            exchange_ghost_rows(u_local, params); // Other color's edge values from the neighbors
+            HEAT_PROFILE_SCOPE(HEAT_PHASE_SOR_SWEEP);
+            double r = sor_sweep_color<T, Acc>(u_local, params.ifirst_comp_local, params.ilast_comp_local,
+                                       params.jfirst_comp_local, params.jlast_comp_local,
+                                       color, parity, params.omega, check);
+            if (r > residual) residual = r;
+        }
+        result.sweeps = sweep;
+
+        if (check) {
+            HEAT_PROFILE_SCOPE(HEAT_PHASE_REDUCE);
+            if (reduce_req != MPI_REQUEST_NULL) {
+                MPI_Wait(&reduce_req, MPI_STATUS_IGNORE);
+                result.residual = global_residual;
+                if (global_residual < params.tolerance) {
+                    result.converged = true;
+                    return result;
+                }
+            }
+            local_residual = residual;
+            MPI_Iallreduce(&local_residual, &global_residual, 1, MPI_DOUBLE, MPI_MAX,
+                           params.cart_comm, &reduce_req);
+        }
+    }
+
+    if (reduce_req != MPI_REQUEST_NULL) {
+        MPI_Wait(&reduce_req, MPI_STATUS_IGNORE);
+        result.residual = global_residual;
+        result.converged = global_residual < params.tolerance;
+    }
+    return result;
+}
+
+// Writes the global grid in the binary format of heat_io.h with MPI-IO. Rank 0
+// writes the header; every rank then writes its own block (without halo)
+// straight from the local grid through a subarray file view, collectively, so
+// no rank ever holds more than its block. If params.text_output is set, rank 0
+// streams the finished file into text_filename.
+template <typename T>
+void write_grid_to_file_mpiio(T** u_local_final, const SimParamsMPI& params,
+                              const char* filename, const char* text_filename) {
+    HEAT_PROFILE_SCOPE(HEAT_PHASE_OUTPUT);
+    MPI_File fh;
+    int err = MPI_File_open(params.cart_comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    if (err != MPI_SUCCESS) {
+        if (params.rank == 0) fprintf(stderr, "Rank 0: Error opening file %s for writing.\n", filename);
+        return;
+    }
+
+    HeatGridHeader header = make_grid_header(params.N_total_pts, params.N_total_pts, sizeof(T));
+    MPI_Offset data_offset = sizeof(header);
+    MPI_File_set_size(fh, data_offset + (MPI_Offset)params.N_total_pts * params.N_total_pts * sizeof(T));
+    if (params.rank == 0) {
+        err = MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    MPI_Datatype file_type = create_block_file_type(params);
+    MPI_Datatype block_type = create_block_memory_type(params);
+    MPI_File_set_view(fh, data_offset, params.scalar_type, file_type, "native", MPI_INFO_NULL);
+    int write_err = MPI_File_write_at_all(fh, 0, u_local_final[0], 1, block_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    MPI_Type_free(&file_type);
+    MPI_Type_free(&block_type);
+
+    int local_failed = (err != MPI_SUCCESS || write_err != MPI_SUCCESS) ? 1 : 0, any_failed = 0;
+    MPI_Allreduce(&local_failed, &any_failed, 1, MPI_INT, MPI_MAX, params.cart_comm);
+    if (params.rank == 0) {
+        if (any_failed) {
+            fprintf(stderr, "Rank 0: Error writing file %s.\n", filename);
+        } else {
+            printf("Rank 0: Final grid written to %s\n", filename);
+            if (params.text_output) {
+                if (convert_grid_binary_to_text(filename, text_filename)) {
+                    printf("Rank 0: Text grid written to %s\n", text_filename);
+                } else {
+                    fprintf(stderr, "Rank 0: Error converting %s to text file %s.\n", filename, text_filename);
+                }
+            }
+        }
+    }
+}
+
+#ifdef HEAT_PROFILE
+// Reduces the per-phase times over the ranks and prints, on rank 0, the
+// min/avg/max per phase and the imbalance ratio max/avg (1.0 = perfectly
+// balanced), plus hardware counters if every rank has them. Writes the
+// Chrome trace when HEAT_PROFILE_TRACE is set; rank 0 collects the events one
+// rank at a time so it never holds more than two ranks' worth.
+void report_phase_profile(const SimParamsMPI& params) {
+    HeatProfiler& p = heat_profiler();
+    double local[HEAT_PHASE_COUNT], t_min[HEAT_PHASE_COUNT], t_max[HEAT_PHASE_COUNT], t_sum[HEAT_PHASE_COUNT];
+    long calls[HEAT_PHASE_COUNT], calls_max[HEAT_PHASE_COUNT];
+    unsigned long long counters[HEAT_PHASE_COUNT * HEAT_PROFILE_NUM_COUNTERS];
+    unsigned long long counters_sum[HEAT_PHASE_COUNT * HEAT_PROFILE_NUM_COUNTERS];
+    for (int ph = 0; ph < HEAT_PHASE_COUNT; ++ph) {
+        local[ph] = p.phases[ph].seconds;
+        calls[ph] = p.phases[ph].calls;
+        for (int c = 0; c < HEAT_PROFILE_NUM_COUNTERS; ++c) {
+            counters[ph * HEAT_PROFILE_NUM_COUNTERS + c] = p.phases[ph].counters[c];
+        }
+    }
+    int have_counters = p.counter_fd >= 0 ? 1 : 0, all_counters = 0;
+    MPI_Reduce(local, t_min, HEAT_PHASE_COUNT, MPI_DOUBLE, MPI_MIN, 0, params.cart_comm);
+    MPI_Reduce(local, t_max, HEAT_PHASE_COUNT, MPI_DOUBLE, MPI_MAX, 0, params.cart_comm);
+    MPI_Reduce(local, t_sum, HEAT_PHASE_COUNT, MPI_DOUBLE, MPI_SUM, 0, params.cart_comm);
+    MPI_Reduce(calls, calls_max, HEAT_PHASE_COUNT, MPI_LONG, MPI_MAX, 0, params.cart_comm);
+    MPI_Reduce(counters, counters_sum, HEAT_PHASE_COUNT * HEAT_PROFILE_NUM_COUNTERS, MPI_UNSIGNED_LONG_LONG,
+               MPI_SUM, 0, params.cart_comm);
+    MPI_Reduce(&have_counters, &all_counters, 1, MPI_INT, MPI_MIN, 0, params.cart_comm);
+
+    if (params.rank == 0) {
+        printf("Phase times over %d ranks (seconds per rank):\n", params.size);
+        printf("  %-14s %10s %10s %10s %9s %10s\n", "phase", "min", "avg", "max", "max/avg", "calls");
+        for (int ph = 0; ph < HEAT_PHASE_COUNT; ++ph) {
+            if (calls_max[ph] == 0) continue;
+            double avg = t_sum[ph] / params.size;
+            printf("  %-14s %10.6f %10.6f %10.6f %9.3f %10ld\n", heat_phase_names[ph], t_min[ph], avg, t_max[ph],
+                   avg > 0.0 ? t_max[ph] / avg : 1.0, calls_max[ph]);
+        }
+        if (all_counters) {
+            printf("Hardware counters (main threads, summed over ranks):\n");
+            printf("  %-14s %16s %16s %6s %14s\n", "phase", "cycles", "instructions", "IPC", "LLC misses");
+            for (int ph = 0; ph < HEAT_PHASE_COUNT; ++ph) {
+                if (calls_max[ph] == 0) continue;
+                const unsigned long long* c = &counters_sum[ph * HEAT_PROFILE_NUM_COUNTERS];
+                printf("  %-14s %16llu %16llu %6.2f %14llu\n", heat_phase_names[ph], c[0], c[1],
+                       c[0] > 0 ? (double)c[1] / c[0] : 0.0, c[2]);
+            }
+        }
+    }
+
+    if (!p.trace_file) return;
+    long count = (long)p.events.size();
+    if (params.rank != 0) {
+        MPI_Send(&count, 1, MPI_LONG, 0, 0, params.cart_comm);
+        MPI_Send(p.events.data(), (int)(count * sizeof(HeatTraceEvent)), MPI_BYTE, 0, 1, params.cart_comm);
+        return;
+    }
+    FILE* file = fopen(p.trace_file, "w");
+    if (!file) fprintf(stderr, "Rank 0: Error opening trace file %s.\n", p.trace_file);
+    if (file) fprintf(file, "{\"traceEvents\":[");
+    if (file) heat_profile_write_trace_events(file, 0, p.events.data(), count, true);
+    bool first = count == 0;
+    std::vector<HeatTraceEvent> events;
+    for (int r = 1; r < params.size; ++r) {
+        long n = 0;
+        MPI_Recv(&n, 1, MPI_LONG, r, 0, params.cart_comm, MPI_STATUS_IGNORE);
+        events.resize(n);
+        MPI_Recv(events.data(), (int)(n * sizeof(HeatTraceEvent)), MPI_BYTE, r, 1, params.cart_comm, MPI_STATUS_IGNORE);
+        if (file) heat_profile_write_trace_events(file, r, events.data(), n, first);
+        if (n > 0) first = false;
+    }
+    if (file) {
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        printf("Rank 0: Trace written to %s%s\n", p.trace_file,
+               p.dropped_events > 0 ? " (rank 0 dropped events past the limit)" : "");
+    }
+}
+#endif
+
+// Times `steps` explicit steps of the configuration in `candidate` (the run's
+// parameters with dims, halo, tiling and threads replaced) on a freshly
+// initialized grid, after one warm-up exchange block. Returns the rate of the
+// slowest rank in MLUPS. Collective over MPI_COMM_WORLD; frees everything it
+// sets up.
+template <typename T, typename Acc>
+double probe_configuration(SimParamsMPI candidate, int steps) {
+    candidate.start_iteration = 0;
+    candidate.end_time = 0.0;
+    candidate.restart_file = NULL;
+    candidate.checkpoint_file = NULL;
+    candidate.checkpoint_every = 0;
+    candidate.checkpoint_seconds = 0.0;
+    candidate.snapshot_every = 0;
+    candidate.rebalance_every = 0;
+    candidate.active_tracking = false; // Time the full grid, not the untouched start
+    setup_mpi_simulation_parameters(candidate);
+
+    double elapsed = 0.0;
+    {
+        LocalGrids<T> local;
+        create_local_grids(local, candidate);
+        initialize_local_grid(local.grid[0].data(), local.grid[1].data(), candidate);
+        DoubleBuffer<T> grids = {local.grid[0].data(), local.grid[1].data()};
+        candidate.max_iterations = candidate.halo_depth;
+        run_mpi_simulation<T, Acc>(grids, local, candidate);
+        MPI_Barrier(candidate.cart_comm);
+        double start = MPI_Wtime();
+        candidate.max_iterations = steps;
+        run_mpi_simulation<T, Acc>(grids, local, candidate);
+        double local_elapsed = MPI_Wtime() - start;
+        MPI_Allreduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, candidate.cart_comm);
+        free_halo_plan(local.plan);
+    }
+    free_mpi_simulation(candidate);
+    return (double)candidate.n_global * candidate.n_global * steps / elapsed / 1e6;
+}
+
+void apply_tuned_config(SimParamsMPI& params, const HeatTunedConfig& config) {
+    params.dims[0] = config.dims[0];
+    params.dims[1] = config.dims[1];
+    params.halo_depth = config.halo_depth;
+    params.tiling = config.tiling;
+    params.num_threads = config.num_threads;
+}
+
+// Probes candidate configurations one parameter at a time: the process grid
+// (every factorization of the rank count), then the halo depth, then the
+// cache tiles (only used between deep-halo exchanges), then the threads per
+// rank. Each stage keeps the fastest candidate so far. All ranks take the
+// same decisions from the same (reduced) timings.
+template <typename T, typename Acc>
+HeatTunedConfig search_configuration(const SimParamsMPI& params, int threads) {
+    const int steps = params.autotune_steps;
+    HeatTunedConfig best;
+    best.mlups = -1.0;
+    auto probe = [&](const HeatTunedConfig& config) {
+        SimParamsMPI candidate = params;
+        apply_tuned_config(candidate, config);
+        double mlups = probe_configuration<T, Acc>(candidate, steps);
+        if (params.rank == 0) {
+            printf("Rank 0: Autotune probe dims %dx%d, halo %d, tile %dx%d x %d, %d threads: %.1f MLUPS\n",
+                   config.dims[0], config.dims[1], config.halo_depth, config.tiling.tile_rows,
+                   config.tiling.tile_cols, config.tiling.time_steps, config.num_threads, mlups);
+        }
+        if (mlups > best.mlups) {
+            best = config;
+            best.mlups = mlups;
+        }
+    };
+
+    HeatTunedConfig config;
+    config.halo_depth = 1;
+    config.tiling.tile_rows = config.tiling.tile_cols = config.tiling.time_steps = 0; // Auto
+    config.num_threads = threads;
+    for (int rows = 1; rows <= params.size; ++rows) {
+        if (params.size % rows != 0 || rows > params.n_global || params.size / rows > params.n_global) continue;
+        config.dims[0] = rows;
+        config.dims[1] = params.size / rows;
+        probe(config);
+    }
+
+    config = best;
+    int max_halo = smallest_block(work_decompose(params.n_global, best.dims[0]));
+    int min_cols = smallest_block(work_decompose(params.n_global, best.dims[1]));
+    if (min_cols < max_halo) max_halo = min_cols;
+    if (steps < max_halo) max_halo = steps;
+    for (int h = 2; h <= max_halo && h <= 16; h *= 2) {
+        config.halo_depth = h;
+        probe(config);
+    }
+
+    if (best.halo_depth > 1) {
+        const int tile_options[3][3] = {{0, 0, 1}, {0, 256, 0}, {0, 1024, 0}}; // Off, narrow, wide
+        for (int t = 0; t < 3; ++t) {
+            config = best;
+            config.tiling.tile_rows = tile_options[t][0];
+            config.tiling.tile_cols = tile_options[t][1];
+            config.tiling.time_steps = tile_options[t][2];
+            probe(config);
+        }
+    }
+
+    for (int n = threads / 2; n >= 1 && n >= threads / 4; n /= 2) {
+        config = best;
+        config.num_threads = n;
+        probe(config);
+    }
+    return best;
+}
+
+// --autotune: takes the configuration for this grid size, rank count,
+// precision and host from the tuning database, or finds it by probing and
+// stores it there. Runs before setup; leaves params ready for it.
+template <typename T, typename Acc>
+void autotune_configuration(SimParamsMPI& params) {
+    if (params.steady || params.adi) {
+        if (params.rank == 0) fprintf(stderr, "--autotune applies to explicit time stepping only; ignored.\n");
+        return;
+    }
+
+    // Nodes in the run, for the host signature
+    MPI_Comm node_comm;
+    int node_rank, leaders = 0;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, params.rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_free(&node_comm);
+    int is_leader = node_rank == 0 ? 1 : 0;
+    MPI_Allreduce(&is_leader, &leaders, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+    HeatTuningKey key;
+    memset(&key, 0, sizeof(key));
+    key.n_global = params.n_global;
+    key.ranks = params.size;
+    snprintf(key.precision, sizeof(key.precision), "%s", heat_precision_name(params.precision));
+    heat_host_signature(key.host, sizeof(key.host), leaders);
+    MPI_Bcast(key.host, sizeof(key.host), MPI_CHAR, 0, MPI_COMM_WORLD); // Rank 0's hardware names the run
+
+    HeatTunedConfig config;
+    int found = 0;
+    if (params.rank == 0 && !params.retune) found = heat_tuning_lookup(params.tuning_db, key, config) ? 1 : 0;
+    MPI_Bcast(&found, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (found) {
+        MPI_Bcast(&config, sizeof(config), MPI_BYTE, 0, MPI_COMM_WORLD);
+        // An entry from another MPI build or a hand edit may not fit; probe instead
+        found = config.dims[0] * config.dims[1] == params.size && config.halo_depth >= 1 && config.num_threads >= 1;
+    }
+
+    if (found) {
+        if (params.rank == 0) printf("Rank 0: Tuned configuration for %s read from %s\n", key.host, params.tuning_db);
+    } else {
+        int threads = params.num_threads > 0 ? params.num_threads : heat_num_threads();
+        double start = MPI_Wtime();
+        config = search_configuration<T, Acc>(params, threads);
+        if (params.rank == 0) {
+            printf("Rank 0: Autotuning took %.3f seconds\n", MPI_Wtime() - start);
+            if (!heat_tuning_store(params.tuning_db, key, config)) {
+                fprintf(stderr, "Rank 0: Error writing tuning database %s.\n", params.tuning_db);
+            }
+        }
+    }
+    // The key does not record thread support, so an entry may come from a run that had it
+    if (params.single_thread) config.num_threads = 1;
+    apply_tuned_config(params, config);
+    if (params.rank == 0) {
+        printf("Rank 0: Using dims %dx%d, halo %d, tile %dx%d x %d, %d threads (%.1f MLUPS when probed)\n",
+               config.dims[0], config.dims[1], config.halo_depth, config.tiling.tile_rows, config.tiling.tile_cols,
+               config.tiling.time_steps, config.num_threads, config.mlups);
+    }
+}
+
+// Allocates the local grids in storage type T, runs the selected mode in Acc
+// arithmetic, writes the result and reports the timing on rank 0. params
+// returns with the final decomposition (--rebalance may change it).
+template <typename T, typename Acc>
+void run_solver(SimParamsMPI& params) {
+    LocalGrids<T> local;
+    create_local_grids(local, params);
+    T** u_old_local = local.grid[0].data();
+    T** u_new_local = local.grid[1].data();
+
+    initialize_local_grid(u_old_local, u_new_local, params);
+    if (params.restart_file) {
+        read_checkpoint_grid(u_old_local, params);
+    }
+    DoubleBuffer<T> grids = {u_old_local, u_new_local};
+
+    double start_time, end_time;
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+
+    SteadyResult steady = {0, 0.0, false};
+    if (params.steady) {
+        steady = run_mpi_steady_simulation<T, Acc>(grids.current, params);
+    } else if (params.adi) {
+        run_mpi_adi_simulation<T, Acc>(grids, params);
+    } else {
+        run_mpi_simulation<T, Acc>(grids, local, params);
+    }
+
+    {
+        HEAT_PROFILE_SCOPE(HEAT_PHASE_BARRIER);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    end_time = MPI_Wtime();
+
+    write_grid_to_file_mpiio(grids.current, params, "output_mpi.bin", "output_mpi.txt");
+
+    if (params.rank == 0) {
+        printf("Finished %d %s for %dx%d grid (%d inner) in %f seconds using %d processes (%dx%d) x %d threads.\n",
+               params.steady ? steady.sweeps : params.max_iterations, params.steady ? "sweeps" : "iterations",
+               params.N_total_pts, params.N_total_pts, params.n_global, end_time - start_time, params.size,
+               params.dims[0], params.dims[1], heat_num_threads());
+        printf("Parameters: c=%.2f, ds=%.4f, dt=%.6f, precision=%s\n", params.c_const, params.ds, params.dt,
+               heat_precision_name(params.precision));
+        if (params.steady) {
+            printf("Steady state %s after %d sweeps (residual %.3e, omega %.4f).\n",
+                   steady.converged ? "reached" : "NOT reached", steady.sweeps, steady.residual, params.omega);
+        }
+        std::cout << std::fixed << std::setprecision(6) << (end_time - start_time) << std::endl;
+    }
+
+    free_halo_plan(local.plan);
+    params.halo = NULL;
+}
+
+int main(int argc, char* argv[]) {
+    SimParamsMPI params;
+    params.n_global = 1000;       // Default global inner grid points
+    params.max_iterations = 1000; // Default iterations
+    params.c_const = 0.1;         // Default heat constant
+    // Initialize boundary values with defaults
+    params.boundary_top = 10.0;    // Default top boundary
+    params.boundary_bottom = 40.0; // Default bottom boundary
+    params.boundary_left = 20.0;   // Default left boundary
+    params.boundary_right = 30.0;  // Default right boundary
+    params.initial_value = 0.0;    // Default interior initial value
+    params.dims[0] = 0;            // Process grid chosen by MPI_Dims_create
+    params.dims[1] = 0;
+    params.halo_depth = 1;         // Exchange halos every step
+    params.tiling.tile_rows = 0;   // Tile sizes auto-detected from the cache size
+    params.tiling.tile_cols = 0;
+    params.tiling.time_steps = 0;
+    params.num_threads = 0;
+    params.single_thread = false;
+    params.steady = false;
+    params.omega = 0.0;            // Optimal SOR factor for the grid size
+    params.tolerance = 1e-6;
+    params.check_every = 10;
+    params.text_output = false;
+    params.checkpoint_file = NULL;
+    params.checkpoint_every = 0;
+    params.checkpoint_seconds = 0.0;
+    params.restart_file = NULL;
+    params.start_iteration = 0;
+    params.precision = HEAT_PRECISION_DOUBLE;
+    params.adi = false;
+    params.dt_request = 0.0;
+    params.end_time = 0.0;
+    params.shared_halos = true;
+    params.active_tracking = true;
+    params.halo = NULL;
+    params.rebalance_every = 0;
+    params.compute_seconds = NULL;
+    params.snapshot_every = 0;
+    params.snapshot_prefix = "snapshot_";
+    params.snapshot_keep = 0;
+    params.snapshot.row0 = params.snapshot.col0 = 0;
+    params.snapshot.rows = params.snapshot.cols = 0; // Whole grid
+    params.snapshot.stride = 1;
+    params.autotune = false;
+    params.retune = false;
+    params.tuning_db = "heat_tuning.db";
+    params.autotune_steps = 50;
+
+    // Threads only run stencil loops and snapshot writes; MPI is always called from the main thread
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+#ifdef HEAT_PROFILE
+    heat_profile_init();
+#endif
+    MPI_Comm_rank(MPI_COMM_WORLD, &params.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &params.size);
+
+    parse_mpi_arguments(argc, argv, params);
+    if (params.restart_file) {
+        read_checkpoint_parameters(params);
+    }
+    if (thread_support < MPI_THREAD_FUNNELED) {
+        if (params.rank == 0 && (heat_num_threads() > 1 || params.num_threads > 1)) {
+            fprintf(stderr, "MPI library lacks MPI_THREAD_FUNNELED support; running single-threaded.\n");
+        }
+        params.num_threads = 1;
+        params.single_thread = true;
+    }
+    if (params.autotune) {
+        switch (params.precision) {
+            case HEAT_PRECISION_FLOAT: autotune_configuration<float, float>(params); break;
+            case HEAT_PRECISION_MIXED: autotune_configuration<float, double>(params); break;
+            default: autotune_configuration<double, double>(params); break;
+        }
+#ifdef HEAT_PROFILE
+        heat_profile_reset(); // Report the run itself, not the probes
+#endif
+    }
+    setup_mpi_simulation_parameters(params);
+
+    switch (params.precision) {
+        case HEAT_PRECISION_FLOAT: run_solver<float, float>(params); break;
+        case HEAT_PRECISION_MIXED: run_solver<float, double>(params); break;
+        default: run_solver<double, double>(params); break;
+    }
+
+#ifdef HEAT_PROFILE
+    report_phase_profile(params);
+#endif
+
+    free_mpi_simulation(params);
+    MPI_Finalize();
+    return 0;
 }
\ No newline at end of file
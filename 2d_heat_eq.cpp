@@ -1,189 +1,512 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h> // For memcpy
-#include <math.h>   // For fabs, if needed for convergence checks (not used here)
-#include <time.h>   // For timing
-#include <fstream>  // For file output
-#include <iostream> // For std::fixed, std::setprecision
-#include <iomanip>  // For std::fixed, std::setprecision
-
-// Structure to hold simulation parameters
-struct SimParams {
-    int n_inner;          // Number of INNER grid points
-    int N_total_pts;      // Total grid points including boundaries (n_inner + 2)
-    int max_iterations;   // Number of time steps
-    double c_const;       // Heat constant
-    double ds;            // Spatial step (delta_s)
-    double dt;            // Time step (delta_t)
-    double boundary_top;
-    double boundary_bottom;
-    double boundary_left;
-    double boundary_right;
-};
-
-// Helper to allocate 2D array
-double** allocate_2d_array(int rows, int cols) {
-    double* data = (double*)malloc(rows * cols * sizeof(double));
-    if (!data) return NULL;
-    double** array = (double**)malloc(rows * sizeof(double*));
-    if (!array) {
-        free(data);
-        return NULL;
-    }
-    for (int i = 0; i < rows; i++) {
-        array[i] = &(data[i * cols]);
-    }
-    return array;
-}
-
-void free_2d_array(double** array) {
-    if (array) {
-        if (array[0]) free(array[0]); // Free the contiguous block
-        free(array); // Free the row pointers
-    }
-}
-
-// Function to print a small section of the grid for debugging
-void print_grid_section(double** grid, int N_total_pts, const char* title) {
-    printf("\n--- %s (showing up to 10x10 or full if smaller) ---\n", title);
-    int print_rows = N_total_pts < 10 ? N_total_pts : 10;
-    int print_cols = N_total_pts < 10 ? N_total_pts : 10;
-    for (int i = 0; i < print_rows; ++i) {
-        for (int j = 0; j < print_cols; ++j) {
-            printf("%6.2f ", grid[i][j]);
-        }
-        printf("\n");
-    }
-    printf("---------------------------------------------------\n");
-}
-
-void parse_arguments(int argc, char* argv[], SimParams& params) {
-    if (argc > 1) params.n_inner = atoi(argv[1]);
-    if (argc > 2) params.max_iterations = atoi(argv[2]);
-    if (argc > 3) params.boundary_top = atof(argv[3]);
-    if (argc > 4) params.boundary_bottom = atof(argv[4]);
-    if (argc > 5) params.boundary_left = atof(argv[5]);
-    if (argc > 6) params.boundary_right = atof(argv[6]);
-}
-
-void setup_simulation_parameters(SimParams& params) {
-    params.N_total_pts = params.n_inner + 2;
-    params.ds = 1.0 / (params.n_inner + 1); // If n_inner inner points, n_inner+1 intervals
-    params.dt = (params.ds * params.ds) / (4.0 * params.c_const); // Stability condition
-
-    // printf("Running 2D Heat Equation (Single Processor)\n");
-    // printf("Grid: %dx%d total points (%dx%d inner points)\n", params.N_total_pts, params.N_total_pts, params.n_inner, params.n_inner);
-    // printf("Iterations: %d\n", params.max_iterations);
-    // printf("c = %.2f, ds = %.4f, dt = %.6f\n", params.c_const, params.ds, params.dt);
-    // printf("Boundaries: T=%.1f, B=%.1f, L=%.1f, R=%.1f\n", params.boundary_top, params.boundary_bottom, params.boundary_left, params.boundary_right);
-}
-
-void initialize_grid(double** u_old, double** u_new, const SimParams& params) {
-    for (int i = 0; i < params.N_total_pts; ++i) {
-        for (int j = 0; j < params.N_total_pts; ++j) {
-            if (i == 0) { // Top boundary
-                u_old[i][j] = params.boundary_top;
-            } else if (i == params.N_total_pts - 1) { // Bottom boundary
-                u_old[i][j] = params.boundary_bottom;
-            } else if (j == 0) { // Left boundary
-                u_old[i][j] = params.boundary_left;
-            } else if (j == params.N_total_pts - 1) { // Right boundary
-                u_old[i][j] = params.boundary_right;
-            } else { // Inner points
-                u_old[i][j] = 0.0; // Or some other initial condition for inner points
-            }
-            u_new[i][j] = u_old[i][j]; // Initialize u_new with the same
-        }
-    }
-}
-
-void run_simulation(double** u_old, double** u_new, const SimParams& params) {
-    for (int iter = 0; iter < params.max_iterations; ++iter) {
-        // Compute u_new based on u_old for interior points
-        for (int i = 1; i < params.N_total_pts - 1; ++i) {
-            for (int j = 1; j < params.N_total_pts - 1; ++j) {
-                u_new[i][j] = u_old[i][j] +
-                    params.c_const * params.dt / (params.ds * params.ds) *
-                    (u_old[i + 1][j] + u_old[i - 1][j] +
-                     u_old[i][j + 1] + u_old[i][j - 1] -
-                     4.0 * u_old[i][j]);
-            }
-        }
-
-        // Update u_old = u_new
-        if (iter < params.max_iterations - 1) { 
-            for (int i_row = 0; i_row < params.N_total_pts; ++i_row) {
-                memcpy(u_old[i_row], u_new[i_row], params.N_total_pts * sizeof(double));
-            }
-        }
-    }
-}
-
-void write_grid_to_file(double** grid, const SimParams& params, const char* filename) {
-    std::ofstream outfile(filename);
-    if (!outfile.is_open()) {
-        fprintf(stderr, "Error opening file %s for writing.\n", filename);
-        return;
-    }
-    outfile << params.N_total_pts << " " << params.N_total_pts << std::endl;
-    for (int i = 0; i < params.N_total_pts; ++i) {
-        for (int j = 0; j < params.N_total_pts; ++j) {
-            outfile << grid[i][j] << (j == params.N_total_pts - 1 ? "" : " ");
-        }
-        outfile << std::endl;
-    }
-    outfile.close();
-    printf("Final grid written to %s\n", filename);
-}
-
-void print_final_results(double** u_final, const SimParams& params, double time_spent) {
-    // printf("\nFinished %d iterations.\n", params.max_iterations);
-    // printf("Time taken: %f seconds.\n", time_spent);
-    std::cout << std::fixed << std::setprecision(6) << time_spent << std::endl;
-
-    // if (params.N_total_pts <= 20) {
-    //     print_grid_section(u_final, params.N_total_pts, "Final u_new (result)");
-    // }
-
-    write_grid_to_file(u_final, params, "output_serial.txt"); // Commented out
-}
-
-int main(int argc, char* argv[]) {
-    SimParams params;
-    params.n_inner = 100;       // Default number of INNER grid points
-    params.max_iterations = 10000; // Default number of time steps
-    params.c_const = 0.1;        // Default heat constant
-    // Default boundary values, will be overwritten by parse_arguments if provided
-    params.boundary_top = 10.0;
-    params.boundary_bottom = 40.0;
-    params.boundary_left = 20.0;
-    params.boundary_right = 30.0;
-
-    parse_arguments(argc, argv, params);
-    setup_simulation_parameters(params);
-
-    double** u_old = allocate_2d_array(params.N_total_pts, params.N_total_pts);
-    double** u_new = allocate_2d_array(params.N_total_pts, params.N_total_pts);
-
-    if (!u_old || !u_new) {
-        fprintf(stderr, "Failed to allocate memory.\n");
-        return 1;
-    }
-
-    initialize_grid(u_old, u_new, params);
-
-    // if (params.N_total_pts <= 20) {
-    //     print_grid_section(u_old, params.N_total_pts, "Initial u_old");
-    // }
-
-    clock_t start_time = clock();
-    run_simulation(u_old, u_new, params);
-    clock_t end_time = clock();
-    double time_spent = (double)(end_time - start_time) / CLOCKS_PER_SEC;
-
-    print_final_results(u_new, params, time_spent); // u_new contains the final state
-
-    free_2d_array(u_old);
-    free_2d_array(u_new);
-    return 0;
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>   // For fabs, if needed for convergence checks (not used here)
+#include <chrono>   // For timing (wall clock; clock() would sum CPU time over threads)
+#include <iostream> // For std::fixed, std::setprecision
+#include <iomanip>  // For std::fixed, std::setprecision
+#include <string>
+#include "heat_kernel.h" // Shared 5-point stencil kernel and aligned grid allocation
+#include "heat_grid.h"   // Grid class, initialization and compile-time specialized stencil
+#include "heat_tiling.h" // Cache-blocked (temporally tiled) time stepping
+#include "heat_steady.h" // Red-black SOR for --steady
+#include "heat_io.h"     // Binary grid files and the streaming text converter
+#include "heat_adi.h"    // Implicit ADI time stepping for --adi
+#include "heat_batch.h"  // Boundary-scenario batches by superposition (--batch)
+#include "heat_active.h" // Skipping tiles the heat front has not reached
+
+// Structure to hold simulation parameters
+struct SimParams {
+    int n_inner;          // Number of INNER grid points
+    int N_total_pts;      // Total grid points including boundaries (n_inner + 2)
+    int max_iterations;   // Number of time steps
+    double c_const;       // Heat constant
+    double ds;            // Spatial step (delta_s)
+    double dt;            // Time step (delta_t)
+    double boundary_top;
+    double boundary_bottom;
+    double boundary_left;
+    double boundary_right;
+    double initial_value; // Interior initial condition
+    StencilTiling tiling; // Cache tile sizes; zero fields are auto-detected
+    int num_threads;      // OpenMP threads (0 = OMP_NUM_THREADS / default)
+    bool steady;          // Solve for the steady state with red-black SOR instead of time stepping
+    double omega;         // SOR over-relaxation factor (0 = optimal for the grid)
+    double tolerance;     // Steady state reached when the largest SOR correction drops below this
+    int check_every;      // Sweeps between residual checks
+    bool text_output;     // Also write the final grid as text (converted from the binary file)
+    HeatPrecision precision; // Grid storage / arithmetic precision
+    bool adi;             // Implicit Peaceman-Rachford ADI steps instead of the explicit stencil
+    double dt_request;    // --dt (0 = the explicit stability limit)
+    double end_time;      // --time: simulated time; overrides max_iterations when > 0
+    const char* batch_file;   // Boundary scenarios to answer (NULL = single run)
+    const char* cache_dir;    // Directory of cached basis fields for --batch
+    const char* batch_output; // Output file prefix for --batch
+    bool active_tracking; // Skip tiles still at the initial value until the front fills the grid
+};
+
+// Outcome of a steady-state solve.
+struct SteadyResult {
+    int sweeps;           // Red-black sweeps performed
+    double residual;      // Largest correction at the last check
+    bool converged;
+};
+
+// Function to print a small section of the grid for debugging
+template <typename T>
+void print_grid_section(T** grid, int N_total_pts, const char* title) {
+    printf("\n--- %s (showing up to 10x10 or full if smaller) ---\n", title);
+    int print_rows = N_total_pts < 10 ? N_total_pts : 10;
+    int print_cols = N_total_pts < 10 ? N_total_pts : 10;
+    for (int i = 0; i < print_rows; ++i) {
+        for (int j = 0; j < print_cols; ++j) {
+            printf("%6.2f ", (double)grid[i][j]);
+        }
+        printf("\n");
+    }
+    printf("---------------------------------------------------\n");
+}
+
+// Positional arguments: n_inner max_iterations top bottom left right.
+// Options (anywhere on the line):
+//   --tile RxC       cache tile size in rows x columns (0 = auto from the cache size)
+//   --tile-steps T   time steps advanced per tile; 1 disables tiling (default auto)
+//   --threads N      OpenMP threads (needs -fopenmp; default OMP_NUM_THREADS)
+//   --steady         solve for the steady state with red-black SOR; max_iterations caps the sweeps
+//   --omega W        SOR factor in (0, 2) (default: optimal for the grid size)
+//   --tol E          steady-state tolerance on the largest correction (default 1e-6)
+//   --check-every N  sweeps between residual checks (default 10)
+//   --text           also write output_serial.txt next to the binary output_serial.bin
+//   --precision P    double (default), float, or mixed (float storage, double arithmetic)
+//   --adi            implicit ADI time stepping; stable for any --dt
+//   --dt DT          time step (default and upper bound for the explicit stencil: ds^2 / (4c))
+//   --time T         simulate up to time T; sets max_iterations to ceil(T / dt)
+//   --initial V      initial value of the interior points (default 0)
+//   --batch FILE     answer every boundary scenario in FILE (see heat_batch.h) instead of one run
+//   --cache DIR      basis field cache for --batch (default heat_basis_cache)
+//   --batch-output P write scenario k to P<k>.bin (default output_batch_)
+//   --no-active      update every point from the first step (no active-region tracking)
+void parse_arguments(int argc, char* argv[], SimParams& params) {
+    int positional = 0;
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--tile") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%dx%d", &params.tiling.tile_rows, &params.tiling.tile_cols) != 2) {
+                params.tiling.tile_rows = params.tiling.tile_cols = 0;
+            }
+            continue;
+        }
+        if (strcmp(argv[a], "--tile-steps") == 0 && a + 1 < argc) {
+            params.tiling.time_steps = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            params.num_threads = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--steady") == 0) {
+            params.steady = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--text") == 0) {
+            params.text_output = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--omega") == 0 && a + 1 < argc) {
+            params.omega = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--tol") == 0 && a + 1 < argc) {
+            params.tolerance = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--check-every") == 0 && a + 1 < argc) {
+            params.check_every = atoi(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--adi") == 0) {
+            params.adi = true;
+            continue;
+        }
+        if (strcmp(argv[a], "--no-active") == 0) {
+            params.active_tracking = false;
+            continue;
+        }
+        if (strcmp(argv[a], "--dt") == 0 && a + 1 < argc) {
+            params.dt_request = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--time") == 0 && a + 1 < argc) {
+            params.end_time = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--initial") == 0 && a + 1 < argc) {
+            params.initial_value = atof(argv[++a]);
+            continue;
+        }
+        if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) {
+            params.batch_file = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--cache") == 0 && a + 1 < argc) {
+            params.cache_dir = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--batch-output") == 0 && a + 1 < argc) {
+            params.batch_output = argv[++a];
+            continue;
+        }
+        if (strcmp(argv[a], "--precision") == 0 && a + 1 < argc) {
+            if (!parse_heat_precision(argv[++a], params.precision)) {
+                fprintf(stderr, "Unknown precision %s (use double, float or mixed).\n", argv[a]);
+                exit(1);
+            }
+            continue;
+        }
+        switch (++positional) {
+            case 1: params.n_inner = atoi(argv[a]); break;
+            case 2: params.max_iterations = atoi(argv[a]); break;
+            case 3: params.boundary_top = atof(argv[a]); break;
+            case 4: params.boundary_bottom = atof(argv[a]); break;
+            case 5: params.boundary_left = atof(argv[a]); break;
+            case 6: params.boundary_right = atof(argv[a]); break;
+            default: break;
+        }
+    }
+}
+
+void setup_simulation_parameters(SimParams& params) {
+    params.N_total_pts = params.n_inner + 2;
+    params.ds = 1.0 / (params.n_inner + 1); // If n_inner inner points, n_inner+1 intervals
+    params.dt = (params.ds * params.ds) / (4.0 * params.c_const); // Stability condition
+    if (params.adi && params.steady) {
+        fprintf(stderr, "--adi and --steady cannot be combined.\n");
+        exit(1);
+    }
+    if (params.batch_file && params.steady) {
+        fprintf(stderr, "--batch works with time stepping only, not --steady.\n");
+        exit(1);
+    }
+    if (params.dt_request > 0.0) {
+        // The explicit stencil diverges above the limit; ADI is stable for any dt
+        if (!params.adi && params.dt_request > params.dt * (1.0 + 1e-12)) {
+            fprintf(stderr, "dt %g exceeds the explicit stability limit %g; use --adi for larger steps.\n",
+                    params.dt_request, params.dt);
+            exit(1);
+        }
+        params.dt = params.dt_request;
+    }
+    if (params.end_time > 0.0) params.max_iterations = (int)ceil(params.end_time / params.dt - 1e-9);
+    heat_set_num_threads(params.num_threads);
+    params.tiling = stencil_auto_tiling(params.n_inner, params.n_inner, params.tiling,
+                                        heat_precision_elem_size(params.precision));
+    if (params.omega <= 0.0 || params.omega >= 2.0) params.omega = sor_optimal_omega(params.n_inner);
+    if (params.check_every < 1) params.check_every = 1;
+
+    // printf("Running 2D Heat Equation (Single Processor)\n");
+    // printf("Grid: %dx%d total points (%dx%d inner points)\n", params.N_total_pts, params.N_total_pts, params.n_inner, params.n_inner);
+    // printf("Iterations: %d\n", params.max_iterations);
+    // printf("c = %.2f, ds = %.4f, dt = %.6f\n", params.c_const, params.ds, params.dt);
+    // printf("Boundaries: T=%.1f, B=%.1f, L=%.1f, R=%.1f\n", params.boundary_top, params.boundary_bottom, params.boundary_left, params.boundary_right);
+}
+
+// Writes the boundary and initial values into both time levels (heat_grid.h).
+template <typename T>
+void initialize_grid(const HeatGrid<T>& u_old, const HeatGrid<T>& u_new, const SimParams& params) {
+    heat_initialize_levels(u_old.data(), u_new.data(), params.N_total_pts, params.N_total_pts, 0, 0, params);
+}
+
+// Steps while most of the grid still holds the initial value, updating only
+// the tiles the front has reached (heat_active.h). Returns the number of
+// steps done; it stops at saturation and leaves the rest to the dense path.
+template <typename T, typename Acc>
+int run_active_steps(DoubleBuffer<T>& grids, const SimParams& params, double coef) {
+    const int N = params.N_total_pts;
+    ActiveTiles<T> active;
+    if (!params.active_tracking ||
+        !active_tiles_init<T, Acc>(active, grids.current, grids.next, N, N, params.initial_value, coef)) {
+        return 0;
+    }
+    const double saturation = params.tiling.time_steps > 1 ? HEAT_ACTIVE_SATURATION_TILED : HEAT_ACTIVE_SATURATION;
+    int iter = 0;
+    while (iter < params.max_iterations) {
+        active_tiles_step<T, Acc>(active, grids.current, grids.next, 1, N - 2, 1, N - 2, coef);
+        grids.swap();
+        ++iter;
+        if (active_tiles_saturated(active, saturation)) break;
+    }
+    return iter;
+}
+
+// Each step reads grids.current and writes grids.next, then the two are swapped,
+// so grids.current always holds the latest state. With temporal tiling the
+// engine alternates the two grids itself and the parity decides the final swap.
+template <typename T, typename Acc>
+void run_simulation(DoubleBuffer<T>& grids, const SimParams& params) {
+    const double coef = params.c_const * params.dt / (params.ds * params.ds);
+    const bool stream = stencil_use_streaming((size_t)params.N_total_pts * params.N_total_pts * sizeof(T));
+    const int last = params.N_total_pts - 2;
+    const int steps = params.max_iterations - run_active_steps<T, Acc>(grids, params, coef);
+
+    if (params.tiling.time_steps > 1) {
+        // Advance several steps per cache tile; every step updates all interior points
+        stencil_advance_tiled<T, Acc>(grids.current, grids.next, steps, coef, params.tiling,
+                              [last](int, int& i0, int& i1, int& j0, int& j1) { i0 = j0 = 1; i1 = j1 = last; });
+        if (steps % 2 != 0) grids.swap();
+        return;
+    }
+
+    for (int iter = 0; iter < steps; ++iter) {
+        // Compute grids.next based on grids.current for interior points
+        HeatStencil<T, Acc, 1, HEAT_FIXED_WIDTH>::region(grids.current, grids.next, 1, last, 1, last, coef, stream);
+        grids.swap();
+    }
+}
+
+// ADI steps: the row half step writes grids.next from grids.current, the
+// column half step writes the new state back into grids.current, so no swap.
+template <typename T, typename Acc>
+void run_adi_simulation(DoubleBuffer<T>& grids, const SimParams& params) {
+    const double r = params.c_const * params.dt / (params.ds * params.ds);
+    const AdiFactors<Acc> factors = adi_make_factors<Acc>(params.n_inner, r);
+    for (int iter = 0; iter < params.max_iterations; ++iter) {
+        adi_row_sweep<T, Acc>(grids.current, grids.next, factors);
+        adi_column_sweep<T, Acc>(grids.next, grids.current, factors);
+    }
+}
+
+// Runs params.max_iterations time steps with the selected scheme; the result
+// is left in grids.current.
+template <typename T, typename Acc>
+void run_time_steps(DoubleBuffer<T>& grids, const SimParams& params) {
+    if (params.adi) {
+        run_adi_simulation<T, Acc>(grids, params);
+    } else {
+        run_simulation<T, Acc>(grids, params);
+    }
+}
+
+// Relaxes grid in place until the largest correction of a checked sweep drops
+// below params.tolerance, or params.max_iterations sweeps have been done. The
+// residual is only tracked on every check_every-th sweep.
+template <typename T, typename Acc>
+SteadyResult run_steady_simulation(T** grid, const SimParams& params) {
+    const int last = params.N_total_pts - 2;
+    SteadyResult result = {0, 0.0, false};
+    for (int sweep = 1; sweep <= params.max_iterations; ++sweep) {
+        bool check = sweep % params.check_every == 0;
+        double red = sor_sweep_color<T, Acc>(grid, 1, last, 1, last, 0, 0, params.omega, check);
+        double black = sor_sweep_color<T, Acc>(grid, 1, last, 1, last, 1, 0, params.omega, check);
+        result.sweeps = sweep;
+        if (check) {
+            result.residual = red > black ? red : black;
+            if (result.residual < params.tolerance) {
+                result.converged = true;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+// Writes the grid in the binary format of heat_io.h and, if params.text_output
+// is set, converts it to text_filename by streaming the binary file.
+template <typename T>
+void write_grid_to_file(T** grid, const SimParams& params, const char* filename, const char* text_filename) {
+    if (!write_grid_binary(filename, grid, params.N_total_pts, params.N_total_pts)) {
+        fprintf(stderr, "Error writing file %s.\n", filename);
+        return;
+    }
+    printf("Final grid written to %s\n", filename);
+    if (params.text_output) {
+        if (!convert_grid_binary_to_text(filename, text_filename)) {
+            fprintf(stderr, "Error converting %s to text file %s.\n", filename, text_filename);
+            return;
+        }
+        printf("Text grid written to %s\n", text_filename);
+    }
+}
+
+template <typename T>
+void print_final_results(T** u_final, const SimParams& params, double time_spent) {
+    // printf("\nFinished %d iterations.\n", params.max_iterations);
+    // printf("Time taken: %f seconds.\n", time_spent);
+    std::cout << std::fixed << std::setprecision(6) << time_spent << std::endl;
+
+    // if (params.N_total_pts <= 20) {
+    //     print_grid_section(u_final, params.N_total_pts, "Final u_new (result)");
+    // }
+
+    write_grid_to_file(u_final, params, "output_serial.bin", "output_serial.txt");
+}
+
+// Answers every scenario of params.batch_file (heat_batch.h). Each basis field
+// is loaded from params.cache_dir, or computed and stored there first.
+// Returns the process exit code.
+template <typename T, typename Acc>
+int run_batch(const SimParams& params) {
+    std::vector<BoundaryScenario> scenarios;
+    if (!read_boundary_scenarios(params.batch_file, scenarios)) return 1;
+    if (!heat_ensure_directory(params.cache_dir)) {
+        fprintf(stderr, "Error creating cache directory %s.\n", params.cache_dir);
+        return 1;
+    }
+
+    const int N = params.N_total_pts;
+    HeatGrid<T> basis[HEAT_SIDE_COUNT], scratch, result;
+    bool allocated = scratch.allocate(params.n_inner, params.n_inner, 1) &&
+                     result.allocate(params.n_inner, params.n_inner, 1);
+    for (int side = 0; side < HEAT_SIDE_COUNT; ++side) {
+        allocated = allocated && basis[side].allocate(params.n_inner, params.n_inner, 1);
+    }
+    if (!allocated) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    int computed = 0;
+    for (int side = 0; side < HEAT_SIDE_COUNT; ++side) {
+        char path[1024];
+        heat_basis_cache_path(path, sizeof(path), params.cache_dir, params.n_inner, params.max_iterations,
+                              params.c_const, params.dt, params.adi, heat_precision_name(params.precision), side);
+        if (read_grid_binary(path, basis[side].data(), N, N)) {
+            printf("Basis %s loaded from %s\n", heat_side_names[side], path);
+            continue;
+        }
+        SimParams unit = params;
+        unit.boundary_top = side == HEAT_SIDE_TOP ? 1.0 : 0.0;
+        unit.boundary_bottom = side == HEAT_SIDE_BOTTOM ? 1.0 : 0.0;
+        unit.boundary_left = side == HEAT_SIDE_LEFT ? 1.0 : 0.0;
+        unit.boundary_right = side == HEAT_SIDE_RIGHT ? 1.0 : 0.0;
+        unit.initial_value = 0.0;
+        initialize_grid(basis[side], scratch, unit);
+        DoubleBuffer<T> grids = {basis[side].data(), scratch.data()};
+        run_time_steps<T, Acc>(grids, unit);
+        if (grids.current != basis[side].data()) std::swap(basis[side], scratch); // Result in the other buffer
+        ++computed;
+
+        // Written under a temporary name so a concurrent batch never reads a partial file
+        std::string tmp_path = std::string(path) + ".tmp";
+        if (write_grid_binary(tmp_path.c_str(), basis[side].data(), N, N) && rename(tmp_path.c_str(), path) == 0) {
+            printf("Basis %s computed and cached in %s\n", heat_side_names[side], path);
+        } else {
+            fprintf(stderr, "Warning: could not cache basis %s in %s.\n", heat_side_names[side], path);
+            remove(tmp_path.c_str());
+        }
+    }
+
+    T** basis_rows[HEAT_SIDE_COUNT];
+    for (int side = 0; side < HEAT_SIDE_COUNT; ++side) basis_rows[side] = basis[side].data();
+    int full_solves = 0;
+    for (size_t k = 0; k < scenarios.size(); ++k) {
+        const BoundaryScenario& s = scenarios[k];
+        T** answer = result.data();
+        if (s.initial != 0.0) {
+            // Not in the span of the basis fields: solve this one in full
+            SimParams full = params;
+            full.boundary_top = s.boundary[HEAT_SIDE_TOP];
+            full.boundary_bottom = s.boundary[HEAT_SIDE_BOTTOM];
+            full.boundary_left = s.boundary[HEAT_SIDE_LEFT];
+            full.boundary_right = s.boundary[HEAT_SIDE_RIGHT];
+            full.initial_value = s.initial;
+            initialize_grid(result, scratch, full);
+            DoubleBuffer<T> grids = {result.data(), scratch.data()};
+            run_time_steps<T, Acc>(grids, full);
+            answer = grids.current;
+            ++full_solves;
+        } else {
+            superpose_boundary_basis<T, Acc>(basis_rows, s.boundary, result.data(), N, N);
+        }
+        char filename[1024], text_filename[1024];
+        snprintf(filename, sizeof(filename), "%s%zu.bin", params.batch_output, k);
+        snprintf(text_filename, sizeof(text_filename), "%s%zu.txt", params.batch_output, k);
+        printf("Scenario %zu (T=%g, B=%g, L=%g, R=%g, initial=%g): %s\n", k, s.boundary[HEAT_SIDE_TOP],
+               s.boundary[HEAT_SIDE_BOTTOM], s.boundary[HEAT_SIDE_LEFT], s.boundary[HEAT_SIDE_RIGHT], s.initial,
+               s.initial != 0.0 ? "full solve" : "superposition");
+        write_grid_to_file(answer, params, filename, text_filename);
+    }
+    std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+    double time_spent = std::chrono::duration<double>(end_time - start_time).count();
+
+    printf("Batch: %zu scenarios (%d solved in full), %d of %d basis fields computed.\n",
+           scenarios.size(), full_solves, computed, (int)HEAT_SIDE_COUNT);
+    std::cout << std::fixed << std::setprecision(6) << time_spent << std::endl;
+    return 0;
+}
+
+// Allocates the grids in storage type T, runs the selected mode in Acc
+// arithmetic and writes the result. Returns the process exit code.
+template <typename T, typename Acc>
+int run_solver(const SimParams& params) {
+    if (params.batch_file) return run_batch<T, Acc>(params);
+
+    HeatGrid<T> u_old, u_new; // Inner points inside a one-cell boundary layer
+    if (!u_old.allocate(params.n_inner, params.n_inner, 1) || !u_new.allocate(params.n_inner, params.n_inner, 1)) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        return 1;
+    }
+
+    initialize_grid(u_old, u_new, params);
+
+    // if (params.N_total_pts <= 20) {
+    //     print_grid_section(u_old, params.N_total_pts, "Initial u_old");
+    // }
+
+    DoubleBuffer<T> grids = {u_old.data(), u_new.data()};
+
+    SteadyResult steady = {0, 0.0, false};
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    if (params.steady) {
+        steady = run_steady_simulation<T, Acc>(grids.current, params);
+    } else {
+        run_time_steps<T, Acc>(grids, params);
+    }
+    std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+    double time_spent = std::chrono::duration<double>(end_time - start_time).count();
+
+    print_final_results(grids.current, params, time_spent); // grids.current contains the final state
+    if (params.steady) {
+        printf("Steady state %s after %d sweeps (residual %.3e, omega %.4f).\n",
+               steady.converged ? "reached" : "NOT reached", steady.sweeps, steady.residual, params.omega);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    SimParams params;
+    params.n_inner = 100;       // Default number of INNER grid points
+    params.max_iterations = 10000; // Default number of time steps
+    params.c_const = 0.1;        // Default heat constant
+    // Default boundary values, will be overwritten by parse_arguments if provided
+    params.boundary_top = 10.0;
+    params.boundary_bottom = 40.0;
+    params.boundary_left = 20.0;
+    params.boundary_right = 30.0;
+    params.initial_value = 0.0;
+    params.tiling.tile_rows = 0;   // Tile sizes auto-detected from the cache size
+    params.tiling.tile_cols = 0;
+    params.tiling.time_steps = 0;
+    params.num_threads = 0;
+    params.steady = false;
+    params.omega = 0.0;            // Optimal SOR factor for the grid size
+    params.tolerance = 1e-6;
+    params.check_every = 10;
+    params.text_output = false;
+    params.precision = HEAT_PRECISION_DOUBLE;
+    params.adi = false;
+    params.dt_request = 0.0;
+    params.end_time = 0.0;
+    params.batch_file = NULL;
+    params.cache_dir = "heat_basis_cache";
+    params.batch_output = "output_batch_";
+    params.active_tracking = true;
+
+    parse_arguments(argc, argv, params);
+    setup_simulation_parameters(params);
+
+    switch (params.precision) {
+        case HEAT_PRECISION_FLOAT: return run_solver<float, float>(params);
+        case HEAT_PRECISION_MIXED: return run_solver<float, double>(params);
+        default: return run_solver<double, double>(params);
+    }
+}
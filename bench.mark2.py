@@ -4,7 +4,7 @@ import csv
 
 MPI_SRC = "2D_HeatEquation_MPI.cpp"
 MPI_EXE = "./heat_equation_2d_mpi"
-CXXFLAGS_COMMON = "-O3 -Wall -std=c++17"
+CXXFLAGS_COMMON = "-O3 -Wall -std=c++17 -fopenmp"
 OUTPUT_CSV = "benchmark_results.csv"
 
 def compile_if_needed(src_file, exe_file, compiler, flags):
@@ -32,7 +32,7 @@ def main():
     # --- Configuration ---
     MPI_SRC = "2D_HeatEquation_MPI.cpp"
     MPI_EXE = "./heat_equation_2d_mpi.exe"
-    CXXFLAGS_COMMON = "-O3 -Wall -std=c++17"
+    CXXFLAGS_COMMON = "-O3 -Wall -std=c++17 -fopenmp"
 
     print("--- 2D Heat Equation Simulation Runner (Python with Random Boundaries) ---")
     
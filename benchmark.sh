@@ -61,7 +61,7 @@ echo "  Left:   $BOUNDARY_LEFT"
 echo "  Right:  $BOUNDARY_RIGHT"
 
 # Define compiler flags (adjust as needed)
-CXXFLAGS_COMMON="-O3 -Wall -std=c++17"
+CXXFLAGS_COMMON="-O3 -Wall -std=c++17 -fopenmp"
 
 echo "\n--- Compilation Check ---"
 compile_if_needed "$MPI_SRC" "$MPI_EXE" "mpic++" "$CXXFLAGS_COMMON"
@@ -0,0 +1,455 @@
+// Non-interactive benchmark driver for the heat solvers.
+//
+//   benchmark_suite [config] [--json FILE] [--csv FILE] [--baseline FILE] [--threshold X]
+//
+// Reads a config file (default benchmark.cfg, see that file for the keys),
+// runs every variant over the strong- and weak-scaling sweeps it describes,
+// and writes one record per case to JSON and CSV. Each case gets `warmup`
+// untimed runs and `trials` timed runs; the time of a run is the one the
+// solver reports (the time-stepping loop only, without setup or output).
+//
+// Reported per case:
+//   MLUPS       million lattice (inner point) updates per second, from the mean time
+//   GB/s        effective bandwidth assuming each update reads and writes one
+//               grid value once (16 bytes in double, 8 with --precision float
+//               or mixed); cache reuse makes the real traffic lower
+//   efficiency  strong: T(p0) p0 / (T(p) p); weak: T(p0) / T(p), where p0 is
+//               the smallest rank count of the same sweep
+//   stddev, cv  spread of the trial times (cv = stddev / mean)
+//
+// With --baseline (a CSV written by an earlier run), each case is matched to
+// the baseline case with the same key and flagged when its MLUPS moved by more
+// than the threshold (default 5%) and by more than twice its own cv.
+// Exit codes: 0 no regression, 1 at least one regression, 2 error.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#define BENCH_OK 0
+#define BENCH_REGRESSION 1
+#define BENCH_ERROR 2
+
+struct BenchVariant {
+    std::string name;
+    bool serial;          // Runs the serial solver (rank count 1 only)
+    std::string args;     // Extra solver arguments
+    int elem_size;        // Bytes per grid value, from --precision in args
+};
+
+struct BenchConfig {
+    std::string mpi_exe;
+    std::string serial_exe;
+    std::string launcher;           // "{procs}" is replaced by the rank count
+    int warmup;
+    int trials;
+    double threshold;               // Relative MLUPS change flagged against the baseline
+    std::vector<int> iterations;
+    std::vector<int> procs;
+    std::vector<int> strong_sizes;  // Inner grid points per side
+    std::vector<long> weak_points;  // Inner grid points per rank
+    std::vector<BenchVariant> variants;
+};
+
+struct BenchCase {
+    std::string scaling;  // "strong" or "weak"
+    const BenchVariant* variant;
+    int n_inner;
+    int iterations;
+    int procs;
+    long sweep_param;     // Grid size (strong) or points per rank (weak); groups a sweep
+    std::vector<double> times;
+    double mean, min, stddev, cv;
+    double mlups, bandwidth_gbs, efficiency;
+    double baseline_mlups; // 0 = not in the baseline
+    const char* verdict;
+};
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+}
+
+// Grid value size of a variant: float storage with --precision float or mixed.
+static int variant_elem_size(const std::string& args) {
+    size_t pos = args.find("--precision ");
+    if (pos == std::string::npos) return (int)sizeof(double);
+    std::string precision = trim(args.substr(pos + 12));
+    precision = precision.substr(0, precision.find(' '));
+    return precision == "float" || precision == "mixed" ? (int)sizeof(float) : (int)sizeof(double);
+}
+
+static bool parse_int_list(const std::string& value, std::vector<long>& out) {
+    out.clear();
+    const char* p = value.c_str();
+    while (*p) {
+        char* end = NULL;
+        long v = strtol(p, &end, 10);
+        if (end == p || v <= 0) return false;
+        out.push_back(v);
+        p = end;
+        while (*p == ' ' || *p == '\t' || *p == ',') ++p;
+    }
+    return !out.empty();
+}
+
+// Config format: "key = value" lines, '#' starts a comment. Lists are comma
+// separated. "variant NAME = [serial|mpi] extra solver args" adds a variant.
+bool read_config(const char* filename, BenchConfig& config) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Error opening config file %s.\n", filename);
+        return false;
+    }
+    char buffer[4096];
+    int line_no = 0;
+    bool ok = true;
+    while (ok && fgets(buffer, sizeof(buffer), file)) {
+        ++line_no;
+        std::string line = buffer;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        line = trim(line);
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            fprintf(stderr, "%s:%d: expected key = value\n", filename, line_no);
+            ok = false;
+            break;
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+        std::vector<long> list;
+
+        if (key.compare(0, 8, "variant ") == 0) {
+            BenchVariant v;
+            v.name = trim(key.substr(8));
+            v.serial = value.compare(0, 6, "serial") == 0 && (value.size() == 6 || value[6] == ' ');
+            if (v.serial || (value.compare(0, 3, "mpi") == 0 && (value.size() == 3 || value[3] == ' '))) {
+                value = trim(value.substr(v.serial ? 6 : 3));
+            }
+            v.args = value;
+            v.elem_size = variant_elem_size(value);
+            ok = !v.name.empty() && v.name.find_first_of(", \"") == std::string::npos;
+            if (ok) config.variants.push_back(v);
+        } else if (key == "mpi_exe") {
+            config.mpi_exe = value;
+        } else if (key == "serial_exe") {
+            config.serial_exe = value;
+        } else if (key == "launcher") {
+            config.launcher = value;
+        } else if (key == "warmup") {
+            config.warmup = atoi(value.c_str());
+            ok = config.warmup >= 0;
+        } else if (key == "trials") {
+            config.trials = atoi(value.c_str());
+            ok = config.trials >= 1;
+        } else if (key == "threshold") {
+            config.threshold = atof(value.c_str());
+            ok = config.threshold > 0.0;
+        } else if (key == "iterations" || key == "procs" || key == "strong_sizes") {
+            ok = parse_int_list(value, list);
+            std::vector<int>& target = key == "iterations" ? config.iterations
+                                     : key == "procs" ? config.procs : config.strong_sizes;
+            target.assign(list.begin(), list.end());
+        } else if (key == "weak_points_per_rank") {
+            ok = parse_int_list(value, config.weak_points);
+        } else {
+            fprintf(stderr, "%s:%d: unknown key '%s'\n", filename, line_no, key.c_str());
+            ok = false;
+            break;
+        }
+        if (!ok) fprintf(stderr, "%s:%d: invalid value for '%s'\n", filename, line_no, key.c_str());
+    }
+    fclose(file);
+    if (ok && config.variants.empty()) {
+        BenchVariant v = {"mpi", false, "", (int)sizeof(double)};
+        config.variants.push_back(v);
+    }
+    return ok;
+}
+
+// Runs one solver invocation and returns the time it reports (the last line
+// of stdout that is a bare number), or a negative value on failure.
+double run_solver(const BenchConfig& config, const BenchCase& c) {
+    std::string command;
+    if (c.variant->serial) {
+        command = config.serial_exe;
+    } else {
+        command = config.launcher;
+        size_t pos = command.find("{procs}");
+        if (pos != std::string::npos) command.replace(pos, 7, std::to_string(c.procs));
+        command += " " + config.mpi_exe;
+    }
+    command += " " + std::to_string(c.n_inner) + " " + std::to_string(c.iterations);
+    if (!c.variant->args.empty()) command += " " + c.variant->args;
+
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) return -1.0;
+    char line[1024];
+    double reported = -1.0;
+    while (fgets(line, sizeof(line), pipe)) {
+        char* end = NULL;
+        double value = strtod(line, &end);
+        if (end != line && trim(end).empty()) reported = value;
+    }
+    int status = pclose(pipe);
+    if (status != 0) {
+        fprintf(stderr, "Command failed (status %d): %s\n", status, command.c_str());
+        return -1.0;
+    }
+    if (reported < 0.0) fprintf(stderr, "No time reported by: %s\n", command.c_str());
+    return reported;
+}
+
+void build_cases(const BenchConfig& config, std::vector<BenchCase>& cases) {
+    for (size_t v = 0; v < config.variants.size(); ++v) {
+        const BenchVariant* variant = &config.variants[v];
+        for (size_t it = 0; it < config.iterations.size(); ++it) {
+            for (size_t p = 0; p < config.procs.size(); ++p) {
+                if (variant->serial && config.procs[p] != 1) continue;
+                BenchCase c;
+                c.variant = variant;
+                c.iterations = config.iterations[it];
+                c.procs = config.procs[p];
+                c.baseline_mlups = 0.0;
+                c.verdict = "";
+                for (size_t s = 0; s < config.strong_sizes.size(); ++s) {
+                    c.scaling = "strong";
+                    c.n_inner = config.strong_sizes[s];
+                    c.sweep_param = c.n_inner;
+                    cases.push_back(c);
+                }
+                for (size_t w = 0; w < config.weak_points.size(); ++w) {
+                    c.scaling = "weak";
+                    c.n_inner = (int)llround(sqrt((double)config.weak_points[w] * c.procs));
+                    c.sweep_param = config.weak_points[w];
+                    cases.push_back(c);
+                }
+            }
+        }
+    }
+}
+
+void compute_statistics(BenchCase& c) {
+    double sum = 0.0;
+    c.min = c.times[0];
+    for (size_t i = 0; i < c.times.size(); ++i) {
+        sum += c.times[i];
+        if (c.times[i] < c.min) c.min = c.times[i];
+    }
+    c.mean = sum / c.times.size();
+    double sq = 0.0;
+    for (size_t i = 0; i < c.times.size(); ++i) sq += (c.times[i] - c.mean) * (c.times[i] - c.mean);
+    c.stddev = c.times.size() > 1 ? sqrt(sq / (c.times.size() - 1)) : 0.0;
+    c.cv = c.mean > 0.0 ? c.stddev / c.mean : 0.0;
+    double updates = (double)c.n_inner * c.n_inner * c.iterations;
+    c.mlups = c.mean > 0.0 ? updates / c.mean / 1e6 : 0.0;
+    c.bandwidth_gbs = c.mlups * 2.0 * c.variant->elem_size / 1e3;
+}
+
+// Efficiency relative to the case with the fewest ranks in the same sweep.
+void compute_efficiency(std::vector<BenchCase>& cases) {
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const BenchCase* ref = NULL;
+        for (size_t j = 0; j < cases.size(); ++j) {
+            const BenchCase& o = cases[j];
+            if (o.scaling == cases[i].scaling && o.variant == cases[i].variant && o.iterations == cases[i].iterations &&
+                o.sweep_param == cases[i].sweep_param && (!ref || o.procs < ref->procs)) {
+                ref = &o;
+            }
+        }
+        BenchCase& c = cases[i];
+        if (c.scaling == "strong") {
+            c.efficiency = ref->mean * ref->procs / (c.mean * c.procs);
+        } else {
+            c.efficiency = ref->mean / c.mean;
+        }
+    }
+}
+
+static std::string case_key(const std::string& scaling, const std::string& variant, int n, int iterations, int procs) {
+    return scaling + "," + variant + "," + std::to_string(n) + "," + std::to_string(iterations) + "," + std::to_string(procs);
+}
+
+// Matches cases against a CSV written by write_csv. Returns the number of regressions.
+int compare_with_baseline(const char* filename, double threshold, std::vector<BenchCase>& cases) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Error opening baseline %s.\n", filename);
+        return -1;
+    }
+    char line[1024];
+    std::vector<std::pair<std::string, double> > baseline;
+    while (fgets(line, sizeof(line), file)) {
+        char scaling[32], variant[256];
+        int n, iterations, procs;
+        double mean, min, stddev, cv, mlups;
+        if (sscanf(line, "%31[^,],%255[^,],%d,%d,%d,%lf,%lf,%lf,%lf,%lf", scaling, variant, &n, &iterations, &procs,
+                   &mean, &min, &stddev, &cv, &mlups) == 10) {
+            baseline.push_back(std::make_pair(case_key(scaling, variant, n, iterations, procs), mlups));
+        }
+    }
+    fclose(file);
+
+    int regressions = 0;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        BenchCase& c = cases[i];
+        std::string key = case_key(c.scaling, c.variant->name, c.n_inner, c.iterations, c.procs);
+        for (size_t b = 0; b < baseline.size(); ++b) {
+            if (baseline[b].first != key || baseline[b].second <= 0.0) continue;
+            c.baseline_mlups = baseline[b].second;
+            double change = c.mlups / c.baseline_mlups - 1.0;
+            double noise = 2.0 * c.cv;
+            if (change < -threshold && -change > noise) {
+                c.verdict = "slower";
+                ++regressions;
+            } else if (change > threshold && change > noise) {
+                c.verdict = "faster";
+            } else {
+                c.verdict = "same";
+            }
+        }
+    }
+    return regressions;
+}
+
+bool write_csv(const char* filename, const std::vector<BenchCase>& cases) {
+    FILE* file = fopen(filename, "w");
+    if (!file) return false;
+    fprintf(file, "scaling,variant,n_inner,iterations,procs,mean_s,min_s,stddev_s,cv,mlups,bandwidth_gbs,efficiency,"
+                  "baseline_mlups,verdict\n");
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const BenchCase& c = cases[i];
+        fprintf(file, "%s,%s,%d,%d,%d,%.6f,%.6f,%.6f,%.4f,%.3f,%.3f,%.4f,%.3f,%s\n", c.scaling.c_str(),
+                c.variant->name.c_str(), c.n_inner, c.iterations, c.procs, c.mean, c.min, c.stddev, c.cv, c.mlups,
+                c.bandwidth_gbs, c.efficiency, c.baseline_mlups, c.verdict);
+    }
+    return fclose(file) == 0;
+}
+
+static std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') out += '\\';
+        out += s[i];
+    }
+    return out + "\"";
+}
+
+bool write_json(const char* filename, const BenchConfig& config, const std::vector<BenchCase>& cases) {
+    FILE* file = fopen(filename, "w");
+    if (!file) return false;
+    fprintf(file, "{\n  \"warmup\": %d,\n  \"trials\": %d,\n  \"cases\": [\n", config.warmup, config.trials);
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const BenchCase& c = cases[i];
+        fprintf(file, "    {\"scaling\": \"%s\", \"variant\": %s, \"solver\": \"%s\", \"args\": %s, "
+                      "\"n_inner\": %d, \"iterations\": %d, \"procs\": %d, \"times_s\": [",
+                c.scaling.c_str(), json_string(c.variant->name).c_str(), c.variant->serial ? "serial" : "mpi",
+                json_string(c.variant->args).c_str(), c.n_inner, c.iterations, c.procs);
+        for (size_t t = 0; t < c.times.size(); ++t) fprintf(file, t ? ", %.6f" : "%.6f", c.times[t]);
+        fprintf(file, "], \"mean_s\": %.6f, \"min_s\": %.6f, \"stddev_s\": %.6f, \"cv\": %.4f, \"mlups\": %.3f, "
+                      "\"bandwidth_gbs\": %.3f, \"efficiency\": %.4f",
+                c.mean, c.min, c.stddev, c.cv, c.mlups, c.bandwidth_gbs, c.efficiency);
+        if (c.baseline_mlups > 0.0) {
+            fprintf(file, ", \"baseline_mlups\": %.3f, \"verdict\": \"%s\"", c.baseline_mlups, c.verdict);
+        }
+        fprintf(file, "}%s\n", i + 1 < cases.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* config_file = "benchmark.cfg";
+    const char* json_file = "benchmark_suite.json";
+    const char* csv_file = "benchmark_suite.csv";
+    const char* baseline_file = NULL;
+    double threshold = 0.0;
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) {
+            json_file = argv[++a];
+        } else if (strcmp(argv[a], "--csv") == 0 && a + 1 < argc) {
+            csv_file = argv[++a];
+        } else if (strcmp(argv[a], "--baseline") == 0 && a + 1 < argc) {
+            baseline_file = argv[++a];
+        } else if (strcmp(argv[a], "--threshold") == 0 && a + 1 < argc) {
+            threshold = atof(argv[++a]);
+        } else if (argv[a][0] != '-') {
+            config_file = argv[a];
+        } else {
+            fprintf(stderr, "Usage: %s [config] [--json FILE] [--csv FILE] [--baseline FILE] [--threshold X]\n", argv[0]);
+            return BENCH_ERROR;
+        }
+    }
+
+    BenchConfig config;
+    config.mpi_exe = "./heat_equation_2d_mpi.exe";
+    config.serial_exe = "./2d_heat_eq.exe";
+    config.launcher = "mpiexec -n {procs}";
+    config.warmup = 1;
+    config.trials = 5;
+    config.threshold = 0.05;
+    if (!read_config(config_file, config)) return BENCH_ERROR;
+    if (threshold > 0.0) config.threshold = threshold;
+    if (config.iterations.empty()) config.iterations.push_back(500);
+    if (config.procs.empty()) config.procs.push_back(1);
+    if (config.strong_sizes.empty() && config.weak_points.empty()) {
+        fprintf(stderr, "Config %s defines neither strong_sizes nor weak_points_per_rank.\n", config_file);
+        return BENCH_ERROR;
+    }
+
+    std::vector<BenchCase> cases;
+    build_cases(config, cases);
+    for (size_t i = 0; i < cases.size(); ++i) {
+        BenchCase& c = cases[i];
+        printf("[%zu/%zu] %s %s n=%d it=%d p=%d: ", i + 1, cases.size(), c.scaling.c_str(), c.variant->name.c_str(),
+               c.n_inner, c.iterations, c.procs);
+        fflush(stdout);
+        for (int w = 0; w < config.warmup; ++w) {
+            if (run_solver(config, c) < 0.0) return BENCH_ERROR;
+        }
+        for (int t = 0; t < config.trials; ++t) {
+            double time = run_solver(config, c);
+            if (time < 0.0) return BENCH_ERROR;
+            c.times.push_back(time);
+        }
+        compute_statistics(c);
+        printf("%.6f s (cv %.1f%%), %.1f MLUPS\n", c.mean, 100.0 * c.cv, c.mlups);
+    }
+    compute_efficiency(cases);
+
+    int regressions = 0;
+    if (baseline_file) {
+        regressions = compare_with_baseline(baseline_file, config.threshold, cases);
+        if (regressions < 0) return BENCH_ERROR;
+    }
+
+    if (!write_csv(csv_file, cases) || !write_json(json_file, config, cases)) {
+        fprintf(stderr, "Error writing %s or %s.\n", csv_file, json_file);
+        return BENCH_ERROR;
+    }
+
+    printf("\n%-6s %-12s %7s %7s %5s %10s %8s %6s %7s %s\n", "scale", "variant", "n", "iters", "procs", "MLUPS", "GB/s",
+           "eff", "cv", baseline_file ? "vs baseline" : "");
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const BenchCase& c = cases[i];
+        printf("%-6s %-12s %7d %7d %5d %10.1f %8.2f %6.2f %6.1f%%", c.scaling.c_str(), c.variant->name.c_str(),
+               c.n_inner, c.iterations, c.procs, c.mlups, c.bandwidth_gbs, c.efficiency, 100.0 * c.cv);
+        if (c.baseline_mlups > 0.0) {
+            printf(" %+6.1f%% %s", 100.0 * (c.mlups / c.baseline_mlups - 1.0),
+                   strcmp(c.verdict, "slower") == 0 ? "REGRESSION" : c.verdict);
+        }
+        printf("\n");
+    }
+    printf("\nResults written to %s and %s.\n", csv_file, json_file);
+    if (regressions > 0) {
+        printf("%d case(s) slower than the baseline by more than %.1f%%.\n", regressions, 100.0 * config.threshold);
+        return BENCH_REGRESSION;
+    }
+    return BENCH_OK;
+}
@@ -1,99 +1,244 @@
-#include <iostream>
-#include <fstream>
-#include <vector>
-#include <string>
-#include <cmath>   // For fabs
-#include <iomanip> // For std::setprecision
-
-// Helper to read a grid from a file
-std::vector<std::vector<double>> read_grid_from_file(const std::string& filename) {
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return {};
-    }
-
-    int rows, cols;
-    infile >> rows >> cols;
-    if (rows <= 0 || cols <= 0) {
-        std::cerr << "Invalid dimensions in file: " << filename << std::endl;
-        return {};
-    }
-
-    std::vector<std::vector<double>> grid(rows, std::vector<double>(cols));
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            if (!(infile >> grid[i][j])) {
-                std::cerr << "Error reading data from file: " << filename << " at " << i << "," << j << std::endl;
-                return {};
-            }
-        }
-    }
-    infile.close();
-    return grid;
-}
-
-int main() {
-    std::string serial_file = "output_serial.txt";
-    std::string mpi_file = "output_mpi.txt";
-
-    std::vector<std::vector<double>> grid_serial = read_grid_from_file(serial_file);
-    std::vector<std::vector<double>> grid_mpi = read_grid_from_file(mpi_file);
-
-    if (grid_serial.empty() || grid_mpi.empty()) {
-        std::cerr << "Failed to read one or both grid files. Exiting." << std::endl;
-        return 1;
-    }
-
-    if (grid_serial.size() != grid_mpi.size() || 
-        (grid_serial.size() > 0 && grid_serial[0].size() != grid_mpi[0].size())) {
-        std::cerr << "Grid dimensions do not match between " << serial_file << " and " << mpi_file << std::endl;
-        std::cerr << "Serial: " << grid_serial.size() << "x" << (grid_serial.empty() ? 0 : grid_serial[0].size()) << std::endl;
-        std::cerr << "MPI:    " << grid_mpi.size() << "x" << (grid_mpi.empty() ? 0 : grid_mpi[0].size()) << std::endl;
-        return 1;
-    }
-
-    double max_diff = 0.0;
-    double sum_sq_diff = 0.0;
-    int diff_count = 0;
-    double tolerance = 1e-5; // Define a suitable tolerance
-
-    int rows = grid_serial.size();
-    int cols = grid_serial[0].size();
-
-    std::cout << std::fixed << std::setprecision(8);
-
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            double diff = std::fabs(grid_serial[i][j] - grid_mpi[i][j]);
-            if (diff > max_diff) {
-                max_diff = diff;
-            }
-            sum_sq_diff += diff * diff;
-            if (diff > tolerance) {
-                diff_count++;
-                // Optionally print differing values for debugging
-                // std::cout << "Difference at (" << i << "," << j << "): Serial=" << grid_serial[i][j]
-                //           << ", MPI=" << grid_mpi[i][j] << ", Diff=" << diff << std::endl;
-            }
-        }
-    }
-
-    double mse = (rows * cols > 0) ? sum_sq_diff / (rows * cols) : 0.0;
-    double rmse = std::sqrt(mse);
-
-    std::cout << "Comparison Results:" << std::endl;
-    std::cout << "-------------------" << std::endl;
-    std::cout << "Max absolute difference: " << max_diff << std::endl;
-    std::cout << "Mean Squared Error (MSE): " << mse << std::endl;
-    std::cout << "Root Mean Squared Error (RMSE): " << rmse << std::endl;
-    std::cout << "Number of values differing by more than tolerance (" << tolerance << "): " << diff_count << std::endl;
-
-    if (diff_count == 0 && max_diff <= tolerance) {
-        std::cout << "\nOutputs are considered close enough." << std::endl;
-    } else {
-        std::cout << "\nOutputs have significant differences." << std::endl;
-    }
-
-    return 0;
-}
\ No newline at end of file
+// Compares two grid files written by the solvers and reports how far apart
+// they are.
+//
+//   compare_outputs [file_a file_b] [--tol T] [--threads N]
+//
+// Each file may be a binary grid (heat_io.h, double or float elements) or the
+// text format; the format is detected from the file contents. Comparing a float
+// or mixed-precision run against a double run reports its accuracy cost. Files
+// are memory-mapped and never loaded as a whole: binary rows are read in place,
+// and text rows are parsed one row per thread into a small buffer. The row loop
+// is an OpenMP reduction.
+//
+// Exit codes: 0 if every value is within the tolerance, 1 if any value is not,
+// 2 on usage, I/O, format or dimension errors.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <charconv>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "heat_io.h"
+#include "heat_kernel.h"
+
+#define COMPARE_OK 0
+#define COMPARE_DIFFERENT 1
+#define COMPARE_ERROR 2
+
+struct GridFile {
+    const char* name;
+    const char* map;                  // Whole file, read-only
+    size_t size;
+    bool binary;
+    uint32_t elem_size;               // Binary: 8 (double) or 4 (float)
+    uint64_t rows;
+    uint64_t cols;
+    const char* data;                 // Binary: first element
+    std::vector<size_t> line_offsets; // Text: start of each row's line, plus end of file
+};
+
+// Maps `name` and reads its dimensions. For text files the row lines are
+// indexed with one memchr pass so that rows can be parsed in any order.
+bool open_grid_file(const char* name, GridFile& grid) {
+    grid.name = name;
+    grid.map = NULL;
+    grid.size = 0;
+    grid.elem_size = 0;
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening file: %s\n", name);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Error reading file: %s\n", name);
+        close(fd);
+        return false;
+    }
+    grid.size = (size_t)st.st_size;
+    void* map = mmap(NULL, grid.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error mapping file: %s\n", name);
+        return false;
+    }
+    grid.map = (const char*)map;
+    madvise(map, grid.size, MADV_SEQUENTIAL);
+
+    const char* end = grid.map + grid.size;
+    grid.binary = grid.size >= sizeof(HeatGridHeader) && memcmp(grid.map, HEAT_GRID_MAGIC, 8) == 0;
+    if (grid.binary) {
+        HeatGridHeader header;
+        memcpy(&header, grid.map, sizeof(header));
+        if (header.version != HEAT_GRID_VERSION || !grid_elem_size_valid(header.elem_size) ||
+            grid.size < sizeof(header) + header.rows * header.cols * header.elem_size) {
+            fprintf(stderr, "Invalid or truncated binary grid: %s\n", name);
+            return false;
+        }
+        grid.rows = header.rows;
+        grid.cols = header.cols;
+        grid.elem_size = header.elem_size;
+        grid.data = grid.map + sizeof(header);
+        return true;
+    }
+
+    // Text: "rows cols" line, then one line per row
+    char* after = NULL;
+    unsigned long long rows = strtoull(grid.map, &after, 10);
+    unsigned long long cols = after < end ? strtoull(after, &after, 10) : 0;
+    const char* line = after < end ? (const char*)memchr(after, '\n', end - after) : NULL;
+    if (rows == 0 || cols == 0 || !line) {
+        fprintf(stderr, "Invalid dimensions in file: %s\n", name);
+        return false;
+    }
+    grid.rows = rows;
+    grid.cols = cols;
+    grid.line_offsets.reserve(rows + 1);
+    for (++line; line < end && grid.line_offsets.size() < rows;) {
+        grid.line_offsets.push_back(line - grid.map);
+        const char* next = (const char*)memchr(line, '\n', end - line);
+        line = next ? next + 1 : end;
+    }
+    grid.line_offsets.push_back(line - grid.map);
+    if (grid.line_offsets.size() != rows + 1) {
+        fprintf(stderr, "File %s has fewer than %llu rows\n", name, rows);
+        return false;
+    }
+    return true;
+}
+
+void close_grid_file(GridFile& grid) {
+    if (grid.map) munmap((void*)grid.map, grid.size);
+    grid.map = NULL;
+}
+
+// Returns row i of the grid as doubles, or NULL if a text row does not hold
+// exactly `cols` numbers. Double rows are read in place; float and text rows
+// are converted into `buffer`.
+const double* grid_row(const GridFile& grid, uint64_t i, std::vector<double>& buffer) {
+    if (grid.binary && grid.elem_size == sizeof(double)) return (const double*)grid.data + i * grid.cols;
+    buffer.resize(grid.cols);
+    if (grid.binary) {
+        const float* row = (const float*)grid.data + i * grid.cols;
+        for (uint64_t j = 0; j < grid.cols; ++j) buffer[j] = row[j];
+        return buffer.data();
+    }
+    const char* p = grid.map + grid.line_offsets[i];
+    const char* end = grid.map + grid.line_offsets[i + 1];
+    for (uint64_t j = 0; j < grid.cols; ++j) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        std::from_chars_result parsed = std::from_chars(p, end, buffer[j]);
+        if (parsed.ec != std::errc()) return NULL;
+        p = parsed.ptr;
+    }
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+    return p == end ? buffer.data() : NULL;
+}
+
+const char* grid_kind(const GridFile& grid) {
+    if (!grid.binary) return "text";
+    return grid.elem_size == sizeof(float) ? "binary float" : "binary double";
+}
+
+int main(int argc, char* argv[]) {
+    const char* files[2] = {"output_serial.bin", "output_mpi.bin"};
+    double tolerance = 1e-5;
+    int num_files = 0;
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--tol") == 0 && a + 1 < argc) {
+            tolerance = atof(argv[++a]);
+        } else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            heat_set_num_threads(atoi(argv[++a]));
+        } else if (argv[a][0] != '-' && num_files < 2) {
+            files[num_files++] = argv[a];
+        } else {
+            fprintf(stderr, "Usage: %s [file_a file_b] [--tol T] [--threads N]\n", argv[0]);
+            return COMPARE_ERROR;
+        }
+    }
+    if (num_files == 1) {
+        fprintf(stderr, "Usage: %s [file_a file_b] [--tol T] [--threads N]\n", argv[0]);
+        return COMPARE_ERROR;
+    }
+
+    GridFile a, b;
+    bool opened_a = open_grid_file(files[0], a);
+    bool opened_b = open_grid_file(files[1], b);
+    if (!opened_a || !opened_b) {
+        fprintf(stderr, "Failed to read one or both grid files. Exiting.\n");
+        close_grid_file(a);
+        close_grid_file(b);
+        return COMPARE_ERROR;
+    }
+    if (a.rows != b.rows || a.cols != b.cols) {
+        fprintf(stderr, "Grid dimensions do not match between %s and %s\n", files[0], files[1]);
+        fprintf(stderr, "%s: %llux%llu\n", files[0], (unsigned long long)a.rows, (unsigned long long)a.cols);
+        fprintf(stderr, "%s: %llux%llu\n", files[1], (unsigned long long)b.rows, (unsigned long long)b.cols);
+        close_grid_file(a);
+        close_grid_file(b);
+        return COMPARE_ERROR;
+    }
+
+    double max_diff = 0.0;
+    double max_rel_diff = 0.0;
+    double sum_sq_diff = 0.0;
+    long long diff_count = 0;
+    long long bad_rows = 0;
+    long long rows = (long long)a.rows;
+    uint64_t cols = a.cols;
+
+    #pragma omp parallel reduction(max:max_diff, max_rel_diff) reduction(+:sum_sq_diff, diff_count, bad_rows)
+    {
+        std::vector<double> buffer_a, buffer_b;
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < rows; ++i) {
+            const double* row_a = grid_row(a, i, buffer_a);
+            const double* row_b = grid_row(b, i, buffer_b);
+            if (!row_a || !row_b) {
+                ++bad_rows;
+                continue;
+            }
+            for (uint64_t j = 0; j < cols; ++j) {
+                double diff = fabs(row_a[j] - row_b[j]);
+                if (diff != diff) diff = INFINITY; // A NaN on either side is a difference
+                if (diff > max_diff) max_diff = diff;
+                double scale = fabs(row_a[j]) > fabs(row_b[j]) ? fabs(row_a[j]) : fabs(row_b[j]);
+                if (scale > 0.0 && diff / scale > max_rel_diff) max_rel_diff = diff / scale;
+                sum_sq_diff += diff * diff;
+                if (diff > tolerance) diff_count++;
+            }
+        }
+    }
+    close_grid_file(a);
+    close_grid_file(b);
+
+    if (bad_rows > 0) {
+        fprintf(stderr, "Error reading data: %lld row(s) do not hold %llu numbers\n", bad_rows, (unsigned long long)cols);
+        return COMPARE_ERROR;
+    }
+
+    double points = (double)rows * (double)cols;
+    double mse = points > 0 ? sum_sq_diff / points : 0.0;
+    double rmse = sqrt(mse);
+
+    printf("Comparison Results:\n");
+    printf("-------------------\n");
+    printf("%s (%s) vs %s (%s)\n", files[0], grid_kind(a), files[1], grid_kind(b));
+    printf("Max absolute difference: %.6e\n", max_diff);
+    printf("Max relative difference: %.3e\n", max_rel_diff);
+    printf("Mean Squared Error (MSE): %.6e\n", mse);
+    printf("Root Mean Squared Error (RMSE): %.6e\n", rmse);
+    printf("Number of values differing by more than tolerance (%.3e): %lld\n", tolerance, diff_count);
+
+    if (diff_count == 0) {
+        printf("\nOutputs are considered close enough.\n");
+        return COMPARE_OK;
+    }
+    printf("\nOutputs have significant differences.\n");
+    return COMPARE_DIFFERENT;
+}
@@ -0,0 +1,241 @@
+#ifndef HEAT_ACTIVE_H
+#define HEAT_ACTIVE_H
+
+// Active-region tracking for the explicit stencil.
+//
+// Both solvers start with every interior cell at one value m (0 by default)
+// and a step moves information by one cell, so for a long time most of the
+// grid still holds m, and updating it gives m again. The covered cells are
+// cut into HEAT_ACTIVE_TILE square tiles, and each time level keeps a "quiet"
+// flag per tile: every cell of the tile holds exactly m. A step skips a tile
+// that is quiet in the destination level (it already holds the answer) when
+// the tile and its four neighbors are quiet in the source level (so the
+// update gives m). Every other tile is updated. A tile that was quiet in the
+// source is rescanned afterwards and stays quiet only if its new values are
+// all m. The active band therefore grows by one cell per step, tracked at
+// tile resolution, and only where values really change: far from the
+// boundary the front underflows to exactly m long before the band reaches it.
+//
+// Tracking needs m to be a fixed point of the update in the run's arithmetic
+// (always the case for m = 0); then skipped cells are bit-identical to
+// computed ones. Once a step updates most of the tiles it covers, the caller
+// drops tracking and returns to the dense path: at HEAT_ACTIVE_SATURATION of
+// them for a plain sweep, or HEAT_ACTIVE_SATURATION_TILED when the dense path
+// is temporally tiled (heat_tiling.h), which already does a step for about
+// half the memory traffic of a plain sweep.
+
+#include <string.h>
+#include <vector>
+#include "heat_kernel.h"
+
+#ifndef HEAT_ACTIVE_TILE
+#define HEAT_ACTIVE_TILE 64        // Tile edge in cells
+#endif
+#define HEAT_ACTIVE_SATURATION 0.9       // Fraction of tiles updated at which tracking stops paying off
+#define HEAT_ACTIVE_SATURATION_TILED 0.5 // ... when the dense path is temporally tiled
+
+template <typename T>
+struct ActiveTiles {
+    const void* base[2];          // First row of each grid, which tells the time levels apart
+    int rows, cols;               // Cells covered, from row-pointer index (0, 0)
+    int tiles_down, tiles_across;
+    std::vector<unsigned char> quiet[2]; // Per level and tile: every cell holds `value`
+    std::vector<int> runs;        // Current call: runs of tiles to update, (first, last) tile column pairs
+    std::vector<int> band_runs;   // ... runs of tile row ti0 + b are band_runs[b] .. band_runs[b + 1] - 1
+    std::vector<int> rescan;      // ... updated tiles that were quiet in the source
+    int plan_rows[2], plan_cols[2]; // ... region planned
+    std::vector<T> reference;     // HEAT_ACTIVE_TILE copies of `value`
+    T value;                      // Interior initial value m
+    long visited, updated;        // Tiles seen and updated since the last saturation check
+};
+
+// True if the update leaves a uniform neighborhood of `value` unchanged, bit for bit.
+template <typename T, typename Acc>
+inline bool active_value_is_fixed(T value, double coef) {
+    T row[3] = {value, value, value};
+    T out = stencil_point<T, Acc>(row, row, row, 1, coef);
+    return memcmp(&out, &value, sizeof(T)) == 0;
+}
+
+template <typename T>
+inline int active_level(const ActiveTiles<T>& active, T* const* grid) {
+    return (const void*)grid[0] == active.base[0] ? 0 : 1;
+}
+
+// True if rows [i0, i1] x columns [j0, j1] of `grid`, at most one tile wide,
+// all hold the value.
+template <typename T>
+inline bool active_cells_hold(const ActiveTiles<T>& active, T* const* grid, int i0, int i1, int j0, int j1) {
+    size_t bytes = (size_t)(j1 - j0 + 1) * sizeof(T);
+    for (int i = i0; i <= i1; ++i) {
+        if (memcmp(grid[i] + j0, active.reference.data(), bytes) != 0) return false;
+    }
+    return true;
+}
+
+// Re-checks rows [i0, i1] x columns [j0, j1] of `grid` after they were
+// written outside a step (initialization, a halo exchange): quiet tiles with
+// any of these cells away from the value are no longer quiet.
+template <typename T>
+void active_tiles_refresh(ActiveTiles<T>& active, T* const* grid, int i0, int i1, int j0, int j1) {
+    if (i0 < 0) i0 = 0;
+    if (j0 < 0) j0 = 0;
+    if (i1 > active.rows - 1) i1 = active.rows - 1;
+    if (j1 > active.cols - 1) j1 = active.cols - 1;
+    if (i0 > i1 || j0 > j1) return;
+    const int S = HEAT_ACTIVE_TILE;
+    unsigned char* quiet = active.quiet[active_level(active, grid)].data();
+    long points = (long)(i1 - i0 + 1) * (j1 - j0 + 1);
+    (void)points;
+    #pragma omp parallel for schedule(static) if (points >= HEAT_PARALLEL_MIN_POINTS)
+    for (int ti = i0 / S; ti <= i1 / S; ++ti) {
+        int r0 = ti * S > i0 ? ti * S : i0;
+        int r1 = ti * S + S - 1 < i1 ? ti * S + S - 1 : i1;
+        for (int tj = j0 / S; tj <= j1 / S; ++tj) {
+            int t = ti * active.tiles_across + tj;
+            int c0 = tj * S > j0 ? tj * S : j0;
+            int c1 = tj * S + S - 1 < j1 ? tj * S + S - 1 : j1;
+            if (quiet[t] && !active_cells_hold(active, grid, r0, r1, c0, c1)) quiet[t] = 0;
+        }
+    }
+}
+
+// Starts tracking the two time levels grid_a and grid_b, `rows` x `cols`
+// cells each, for the interior value `value`. Returns false (tracking off)
+// if the value is not a fixed point of the update with this coef.
+template <typename T, typename Acc>
+bool active_tiles_init(ActiveTiles<T>& active, T* const* grid_a, T* const* grid_b, int rows, int cols,
+                       double value, double coef) {
+    T m = (T)value;
+    if (!active_value_is_fixed<T, Acc>(m, coef)) return false;
+    active.base[0] = grid_a[0];
+    active.base[1] = grid_b[0];
+    active.rows = rows;
+    active.cols = cols;
+    active.tiles_down = (rows + HEAT_ACTIVE_TILE - 1) / HEAT_ACTIVE_TILE;
+    active.tiles_across = (cols + HEAT_ACTIVE_TILE - 1) / HEAT_ACTIVE_TILE;
+    active.reference.assign(HEAT_ACTIVE_TILE, m);
+    active.value = m;
+    active.visited = active.updated = 0;
+    for (int level = 0; level < 2; ++level) {
+        active.quiet[level].assign((size_t)active.tiles_down * active.tiles_across, 1);
+    }
+    active_tiles_refresh(active, grid_a, 0, rows - 1, 0, cols - 1);
+    active_tiles_refresh(active, grid_b, 0, rows - 1, 0, cols - 1);
+    return true;
+}
+
+// Plans one step src -> dst over rows [i_begin, i_end] x columns
+// [j_begin, j_end] (inclusive, like stencil_region): picks the tiles that do
+// not already hold the result and merges adjacent ones into runs, so the
+// kernel keeps streaming long rows instead of hopping between tiles. Returns
+// the number of tiles to update.
+template <typename T>
+long active_tiles_plan(ActiveTiles<T>& active, T* const* src, T* const* dst,
+                       int i_begin, int i_end, int j_begin, int j_end) {
+    active.runs.clear();
+    active.band_runs.clear();
+    active.rescan.clear();
+    active.plan_rows[0] = i_begin;
+    active.plan_rows[1] = i_end;
+    active.plan_cols[0] = j_begin;
+    active.plan_cols[1] = j_end;
+    if (i_begin > i_end || j_begin > j_end) return 0;
+    const int S = HEAT_ACTIVE_TILE;
+    const int across = active.tiles_across;
+    const int ti0 = i_begin / S;
+    const unsigned char* quiet_src = active.quiet[active_level(active, src)].data();
+    unsigned char* quiet_dst = active.quiet[active_level(active, dst)].data();
+
+    long updated = 0;
+    for (int ti = ti0; ti <= i_end / S; ++ti) {
+        active.band_runs.push_back((int)active.runs.size() / 2);
+        for (int tj = j_begin / S; tj <= j_end / S; ++tj) {
+            int t = ti * across + tj;
+            bool settled = quiet_dst[t] && quiet_src[t] &&
+                           (ti == 0 || quiet_src[t - across]) && (ti + 1 == active.tiles_down || quiet_src[t + across]) &&
+                           (tj == 0 || quiet_src[t - 1]) && (tj + 1 == across || quiet_src[t + 1]);
+            if (settled) continue;
+            if ((int)active.runs.size() / 2 > active.band_runs.back() && active.runs.back() == tj - 1) {
+                active.runs.back() = tj;
+            } else {
+                active.runs.push_back(tj);
+                active.runs.push_back(tj);
+            }
+            // Only a tile that held the value can still hold it; the rest stay active
+            if (quiet_src[t]) active.rescan.push_back(t);
+            quiet_dst[t] = 0;
+            ++updated;
+        }
+    }
+    active.band_runs.push_back((int)active.runs.size() / 2);
+    active.visited += (long)(i_end / S - ti0 + 1) * (j_end / S - j_begin / S + 1);
+    active.updated += updated;
+    return updated;
+}
+
+// Updates rows [i0, i1] of the planned region on the calling thread.
+template <typename T, typename Acc>
+void active_tiles_sweep(const ActiveTiles<T>& active, T* const* src, T* const* dst, int i0, int i1, double coef) {
+    const int S = HEAT_ACTIVE_TILE;
+    const int ti0 = active.plan_rows[0] / S;
+    const int j_begin = active.plan_cols[0], j_end = active.plan_cols[1];
+    StencilRowKernelT<T> kernel = stencil_row_kernel<T, Acc>();
+    const int* runs = active.runs.data();
+    const int* band_runs = active.band_runs.data();
+    for (int i = i0; i <= i1; ++i) {
+        int band = i / S - ti0;
+        for (int r = band_runs[band]; r < band_runs[band + 1]; ++r) {
+            int j0 = runs[2 * r] * S > j_begin ? runs[2 * r] * S : j_begin;
+            int j1 = runs[2 * r + 1] * S + S - 1 < j_end ? runs[2 * r + 1] * S + S - 1 : j_end;
+            kernel(src[i - 1], src[i], src[i + 1], dst[i], j0, j1, coef, false);
+        }
+    }
+}
+
+// Completes a planned step once the whole region was swept: the updated
+// tiles that were quiet in the source are quiet in dst if they still hold
+// the value.
+template <typename T>
+void active_tiles_rescan(ActiveTiles<T>& active, T* const* dst) {
+    const int S = HEAT_ACTIVE_TILE;
+    const int across = active.tiles_across;
+    unsigned char* quiet_dst = active.quiet[active_level(active, dst)].data();
+    const int count = (int)active.rescan.size();
+    #pragma omp parallel for schedule(static) if ((long)count * S * S >= HEAT_PARALLEL_MIN_POINTS)
+    for (int w = 0; w < count; ++w) {
+        int t = active.rescan[w];
+        int tile_i0 = t / across * S, tile_j0 = t % across * S;
+        int tile_i1 = tile_i0 + S - 1 < active.rows - 1 ? tile_i0 + S - 1 : active.rows - 1;
+        int tile_j1 = tile_j0 + S - 1 < active.cols - 1 ? tile_j0 + S - 1 : active.cols - 1;
+        quiet_dst[t] = active_cells_hold(active, dst, tile_i0, tile_i1, tile_j0, tile_j1);
+    }
+}
+
+// One step src -> dst over rows [i_begin, i_end] x columns [j_begin, j_end],
+// skipping the tiles that already hold the result. The ring of cells the
+// region reads must be covered too.
+template <typename T, typename Acc>
+void active_tiles_step(ActiveTiles<T>& active, T* const* src, T* const* dst,
+                       int i_begin, int i_end, int j_begin, int j_end, double coef) {
+    long updated = active_tiles_plan(active, src, dst, i_begin, i_end, j_begin, j_end);
+    if (updated == 0) return;
+    long points = updated * HEAT_ACTIVE_TILE * HEAT_ACTIVE_TILE;
+    (void)points;
+    #pragma omp parallel for schedule(static) if (points >= HEAT_PARALLEL_MIN_POINTS)
+    for (int i = i_begin; i <= i_end; ++i) {
+        active_tiles_sweep<T, Acc>(active, src, dst, i, i, coef);
+    }
+    active_tiles_rescan(active, dst);
+}
+
+// True once the steps since the last call updated at least `fraction` of the
+// tiles they covered. Resets the counts.
+template <typename T>
+bool active_tiles_saturated(ActiveTiles<T>& active, double fraction) {
+    bool saturated = active.visited > 0 && active.updated >= fraction * active.visited;
+    active.visited = active.updated = 0;
+    return saturated;
+}
+
+#endif // HEAT_ACTIVE_H
@@ -0,0 +1,134 @@
+#ifndef HEAT_ADI_H
+#define HEAT_ADI_H
+
+// Peaceman-Rachford ADI time stepping (--adi), unconditionally stable for any
+// dt. With r = c dt / ds^2, a step is two half steps, each implicit along one
+// axis and explicit along the other:
+//
+//   (1 + r) u*_ij - r/2 (u*_i,j-1 + u*_i,j+1) = (1 - r) u_ij + r/2 (u_i-1,j + u_i+1,j)
+//   (1 + r) v_ij  - r/2 (v_i-1,j  + v_i+1,j)  = (1 - r) u*_ij + r/2 (u*_i,j-1 + u*_i,j+1)
+//
+// Every grid line is a tridiagonal system with the same constant coefficients,
+// so the Thomas-algorithm factors are computed once and shared by all lines.
+// A line is stored with its two boundary values at both ends; the boundary
+// terms then fall out of the regular forward and backward sweeps.
+//
+// The row half step solves one line per row. The column half step solves a
+// batch of columns together, sweeping down the rows so the inner loop runs
+// over contiguous columns and vectorizes. Both evaluate exactly the same
+// expressions as adi_solve_line, so the MPI solver (which transposes lines
+// between ranks and calls adi_solve_line) gives bit-identical results.
+
+#include <vector>
+#include "heat_kernel.h"
+
+template <typename Acc>
+struct AdiFactors {
+    int n;                      // Unknowns per line (inner points)
+    Acc half_r;                 // r / 2
+    Acc one_minus_r;            // 1 - r
+    std::vector<Acc> inv_denom; // [1..n] 1 / pivot of the forward sweep
+    std::vector<Acc> cp;        // [1..n] r/2 / pivot (negated super-diagonal after elimination)
+};
+
+template <typename Acc>
+inline AdiFactors<Acc> adi_make_factors(int n, double r) {
+    AdiFactors<Acc> f;
+    f.n = n;
+    f.half_r = (Acc)(0.5 * r);
+    f.one_minus_r = (Acc)(1.0 - r);
+    f.inv_denom.assign(n + 2, (Acc)0);
+    f.cp.assign(n + 2, (Acc)0);
+    double cp_prev = 0.0;
+    for (int i = 1; i <= n; ++i) {
+        double inv = 1.0 / (1.0 + r - 0.5 * r * cp_prev);
+        f.inv_denom[i] = (Acc)inv;
+        f.cp[i] = (Acc)(0.5 * r * inv);
+        cp_prev = 0.5 * r * inv;
+    }
+    return f;
+}
+
+// Explicit part of a half step: (1 - r) center + r/2 (a + b).
+template <typename T, typename Acc>
+inline Acc adi_rhs(const AdiFactors<Acc>& f, T center, T a, T b) {
+    return f.one_minus_r * (Acc)center + f.half_r * ((Acc)a + (Acc)b);
+}
+
+// Solves one line in place. On entry line[0] and line[n + 1] hold the boundary
+// values and line[1..n] the right-hand side; on return line[1..n] holds the
+// solution.
+template <typename Acc>
+inline void adi_solve_line(Acc* line, const AdiFactors<Acc>& f) {
+    for (int i = 1; i <= f.n; ++i) {
+        line[i] = (line[i] + f.half_r * line[i - 1]) * f.inv_denom[i];
+    }
+    for (int i = f.n; i >= 1; --i) {
+        line[i] = line[i] + f.cp[i] * line[i + 1];
+    }
+}
+
+// Row half step over an (n + 2)^2 grid: dst rows 1..n, implicit along j.
+template <typename T, typename Acc>
+void adi_row_sweep(T* const* src, T* const* dst, const AdiFactors<Acc>& f) {
+    const int n = f.n;
+    #pragma omp parallel
+    {
+        std::vector<Acc> line(n + 2);
+        #pragma omp for schedule(static)
+        for (int i = 1; i <= n; ++i) {
+            line[0] = (Acc)src[i][0];
+            line[n + 1] = (Acc)src[i][n + 1];
+            for (int j = 1; j <= n; ++j) {
+                line[j] = adi_rhs<T, Acc>(f, src[i][j], src[i - 1][j], src[i + 1][j]);
+            }
+            adi_solve_line(line.data(), f);
+            for (int j = 1; j <= n; ++j) {
+                dst[i][j] = (T)line[j];
+            }
+        }
+    }
+}
+
+// Column half step over an (n + 2)^2 grid: dst columns 1..n, implicit along i.
+// Columns are solved in batches of `batch` side by side.
+template <typename T, typename Acc>
+void adi_column_sweep(T* const* src, T* const* dst, const AdiFactors<Acc>& f) {
+    const int n = f.n;
+    const int batch = 128;
+    const int num_batches = (n + batch - 1) / batch;
+    #pragma omp parallel
+    {
+        std::vector<Acc> work((size_t)(n + 2) * batch);
+        #pragma omp for schedule(static)
+        for (int b = 0; b < num_batches; ++b) {
+            int j0 = 1 + b * batch;
+            int width = n + 1 - j0 < batch ? n + 1 - j0 : batch;
+            Acc* w = work.data();
+            for (int jj = 0; jj < width; ++jj) {
+                w[jj] = (Acc)src[0][j0 + jj];
+                w[(size_t)(n + 1) * batch + jj] = (Acc)src[n + 1][j0 + jj];
+            }
+            for (int i = 1; i <= n; ++i) {
+                Acc* wi = w + (size_t)i * batch;
+                const Acc* wp = wi - batch;
+                const T* row = src[i] + j0;
+                for (int jj = 0; jj < width; ++jj) {
+                    Acc rhs = adi_rhs<T, Acc>(f, row[jj], row[jj - 1], row[jj + 1]);
+                    wi[jj] = (rhs + f.half_r * wp[jj]) * f.inv_denom[i];
+                }
+            }
+            for (int i = n; i >= 1; --i) {
+                Acc* wi = w + (size_t)i * batch;
+                const Acc* wn = wi + batch;
+                T* out = dst[i] + j0;
+                for (int jj = 0; jj < width; ++jj) {
+                    wi[jj] = wi[jj] + f.cp[i] * wn[jj];
+                    out[jj] = (T)wi[jj];
+                }
+            }
+        }
+    }
+}
+
+#endif // HEAT_ADI_H
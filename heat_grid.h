@@ -0,0 +1,219 @@
+#ifndef HEAT_GRID_H
+#define HEAT_GRID_H
+
+// Grid and stencil library shared by the serial solver, the MPI solver and the
+// kernel benchmark (stencil_bench.cpp). Header-only, like the rest of the
+// heat_*.h files.
+//
+// HeatGrid<T> owns (or lays out over caller storage) a rows x cols block of
+// cells surrounded by `halo` layers on every side: the fixed boundary in the
+// serial solver, the ghost cells of a rank's block in the MPI solver. Storage
+// comes from allocate_aligned_grid, so rows are padded and 64-byte aligned,
+// and row pointers (data()) are what the kernels take.
+//
+// HeatStencil<T, Acc, Halo, Width> is the 5-point update of heat_kernel.h
+// with the grid geometry as template parameters. Width = 0 (the default)
+// handles any width through the runtime-dispatched SIMD row kernels. A
+// nonzero Width is a compile-time row length: regions exactly that wide run
+// a loop with a constant trip count, which the compiler unrolls and
+// vectorizes for the build's target (-march) with no peeling or remainder
+// checks; other regions fall back to the runtime path. It evaluates the
+// same expression without FMA contraction, so results stay bit-identical.
+//
+// Fixed-size production builds set the width with -DHEAT_FIXED_WIDTH=<n>,
+// where n is the number of inner points per row (serial) or the columns a
+// rank updates (MPI); the solvers use HeatStencil<T, Acc, 1, HEAT_FIXED_WIDTH>.
+
+#include <stdlib.h>
+#include <utility>
+#include "heat_kernel.h"
+
+#ifndef HEAT_FIXED_WIDTH
+#define HEAT_FIXED_WIDTH 0 // Compile-time row width of the solvers' kernel (0 = any width)
+#endif
+
+template <typename T>
+class HeatGrid {
+public:
+    HeatGrid() : rows_(0), cols_(0), halo_(0), stride_(0), row_ptrs_(NULL), owned_(false) {}
+    ~HeatGrid() { release(); }
+    HeatGrid(const HeatGrid&) = delete;
+    HeatGrid& operator=(const HeatGrid&) = delete;
+    HeatGrid(HeatGrid&& other) noexcept : HeatGrid() { swap(other); }
+    HeatGrid& operator=(HeatGrid&& other) noexcept {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    // Allocates the grid. The cells are left untouched (first touch, see
+    // heat_kernel.h). Returns false if out of memory.
+    bool allocate(int rows, int cols, int halo) {
+        release();
+        row_ptrs_ = allocate_aligned_grid<T>(rows + 2 * halo, cols + 2 * halo, &stride_);
+        if (!row_ptrs_) return false;
+        set_shape(rows, cols, halo);
+        owned_ = true;
+        return true;
+    }
+
+    // Lays the grid out over `cells`, which the caller owns and frees (e.g. a
+    // segment of an MPI shared window): storage_bytes(rows, cols, halo) bytes,
+    // 64-byte aligned. Returns false if out of memory.
+    bool wrap(T* cells, int rows, int cols, int halo) {
+        release();
+        int total_rows = rows + 2 * halo;
+        row_ptrs_ = (T**)malloc(total_rows * sizeof(T*));
+        if (!row_ptrs_) return false;
+        stride_ = aligned_grid_stride(cols + 2 * halo, sizeof(T));
+        for (int i = 0; i < total_rows; ++i) {
+            row_ptrs_[i] = cells + (size_t)i * stride_;
+        }
+        set_shape(rows, cols, halo);
+        owned_ = false;
+        return true;
+    }
+
+    // Frees the storage (owned) or the row pointers (wrapped).
+    void release() {
+        if (owned_) {
+            free_aligned_grid(row_ptrs_);
+        } else {
+            free(row_ptrs_);
+        }
+        row_ptrs_ = NULL;
+        owned_ = false;
+        set_shape(0, 0, 0);
+    }
+
+    static size_t storage_bytes(int rows, int cols, int halo) {
+        return (size_t)(rows + 2 * halo) * aligned_grid_stride(cols + 2 * halo, sizeof(T)) * sizeof(T);
+    }
+
+    T** data() const { return row_ptrs_; } // Row pointers; row 0 is the first halo row
+    T* operator[](int i) const { return row_ptrs_[i]; }
+    bool empty() const { return row_ptrs_ == NULL; }
+    int rows() const { return rows_; }     // Cells inside the halo
+    int cols() const { return cols_; }
+    int halo() const { return halo_; }
+    int total_rows() const { return rows_ + 2 * halo_; }
+    int total_cols() const { return cols_ + 2 * halo_; }
+    int stride() const { return stride_; } // Padded row length in elements
+
+private:
+    void set_shape(int rows, int cols, int halo) {
+        rows_ = rows;
+        cols_ = cols;
+        halo_ = halo;
+        if (!row_ptrs_) stride_ = 0;
+    }
+    void swap(HeatGrid& other) {
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(halo_, other.halo_);
+        std::swap(stride_, other.stride_);
+        std::swap(row_ptrs_, other.row_ptrs_);
+        std::swap(owned_, other.owned_);
+    }
+
+    int rows_, cols_, halo_, stride_;
+    T** row_ptrs_;
+    bool owned_;              // Storage allocated here (false: wrapped or empty)
+};
+
+// Two time levels of a grid. Boundary cells are written to both at
+// initialization and never updated (ghost cells are refreshed in the current
+// level before they are read), so swapping by pointer replaces the per-step
+// copy of the whole grid.
+template <typename T>
+struct DoubleBuffer {
+    T** current;          // Latest state, read by the next step
+    T** next;             // Written by the next step
+    void swap() {
+        T** tmp = current;
+        current = next;
+        next = tmp;
+    }
+};
+
+// Initial value of global cell (i, j) of the N_total_pts^2 problem described
+// by params (SimParams or SimParamsMPI): the top and bottom rows (corners
+// included), the left and right columns, then the interior initial value.
+template <typename Params>
+inline double heat_initial_value(const Params& params, int i, int j) {
+    if (i == 0) return params.boundary_top;
+    if (i == params.N_total_pts - 1) return params.boundary_bottom;
+    if (j == 0) return params.boundary_left;
+    if (j == params.N_total_pts - 1) return params.boundary_right;
+    return params.initial_value; // f(x, y)
+}
+
+// Fills all rows x cols cells of both time levels, where local cell (0, 0) is
+// global cell (row0, col0). Cells outside the global grid (halo beyond the
+// edge, never read) are zeroed. Each thread initializes the rows
+// heat_owned_rows gives it, so each page is first touched by the thread
+// (NUMA node) that computes it.
+template <typename T, typename Params>
+void heat_initialize_levels(T** a, T** b, int rows, int cols, int row0, int col0, const Params& params) {
+    #pragma omp parallel
+    {
+        int first, last;
+        heat_owned_rows(rows, heat_thread_num(), heat_team_size(), first, last);
+        for (int i = first; i <= last; ++i) {
+            int i_global = row0 + i;
+            for (int j = 0; j < cols; ++j) {
+                int j_global = col0 + j;
+                bool inside = i_global >= 0 && i_global < params.N_total_pts &&
+                              j_global >= 0 && j_global < params.N_total_pts;
+                a[i][j] = (T)(inside ? heat_initial_value(params, i_global, j_global) : 0.0);
+                b[i][j] = a[i][j];
+            }
+        }
+    }
+}
+
+// Rows [i_begin, i_end] of a region exactly Width columns wide from j_begin.
+template <typename T, typename Acc, int Width>
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("fp-contract=off")))
+#endif
+void stencil_region_fixed(T* const* src, T* const* dst, int i_begin, int i_end, int j_begin, double coef) {
+    long points = (long)(i_end - i_begin + 1) * Width;
+    (void)points;
+    #pragma omp parallel for schedule(static) if (points >= HEAT_PARALLEL_MIN_POINTS && !heat_in_parallel())
+    for (int i = i_begin; i <= i_end; ++i) {
+        const T* up = src[i - 1] + j_begin;
+        const T* row = src[i] + j_begin;
+        const T* down = src[i + 1] + j_begin;
+        T* out = dst[i] + j_begin;
+        const Acc c = (Acc)coef;
+        for (int j = 0; j < Width; ++j) { // Same expression as stencil_point, written out so it inlines here
+            Acc m = row[j];
+            out[j] = (T)(m + c * ((Acc)down[j] + (Acc)up[j] + (Acc)row[j + 1] + (Acc)row[j - 1] - (Acc)4.0 * m));
+        }
+    }
+}
+
+template <typename T, typename Acc = T, int Halo = 1, int Width = 0>
+struct HeatStencil {
+    // Updates rows [i_begin, i_end] x columns [j_begin, j_end] (inclusive,
+    // row-pointer indices) of dst from src, like stencil_region.
+    static void region(T* const* src, T* const* dst, int i_begin, int i_end, int j_begin, int j_end,
+                       double coef, bool stream) {
+        if (Width > 0 && j_end - j_begin + 1 == Width && i_begin <= i_end) {
+            stencil_region_fixed<T, Acc, (Width > 0 ? Width : 1)>(src, dst, i_begin, i_end, j_begin, coef);
+        } else {
+            stencil_region<T, Acc>(src, dst, i_begin, i_end, j_begin, j_end, coef, stream);
+        }
+    }
+
+    // One step over every cell inside the halo of grids allocated with
+    // halo == Halo (for the serial solver: all inner points).
+    static void step(const HeatGrid<T>& src, const HeatGrid<T>& dst, double coef, bool stream) {
+        region(src.data(), dst.data(), Halo, Halo + src.rows() - 1, Halo, Halo + src.cols() - 1, coef, stream);
+    }
+};
+
+#endif // HEAT_GRID_H
@@ -0,0 +1,152 @@
+#ifndef HEAT_IO_H
+#define HEAT_IO_H
+
+// Binary grid file format shared by the solvers and compare_outputs.
+//
+//   offset  0: char[8]  magic "HEATGRD1"
+//   offset  8: uint32   format version (1)
+//   offset 12: uint32   element size in bytes (8 = double, 4 = float)
+//   offset 16: uint64   rows
+//   offset 24: uint64   cols
+//   offset 32: rows x cols elements, row-major, native byte order
+//
+// The fixed-size header lets every MPI rank compute the file offset of its
+// own block and write it in parallel. Text output is produced from the binary
+// file by a streaming converter that holds one row at a time.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define HEAT_GRID_MAGIC "HEATGRD1"
+#define HEAT_GRID_VERSION 1
+
+struct HeatGridHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t elem_size;
+    uint64_t rows;
+    uint64_t cols;
+};
+
+inline HeatGridHeader make_grid_header(int rows, int cols, int elem_size) {
+    HeatGridHeader header;
+    memcpy(header.magic, HEAT_GRID_MAGIC, sizeof(header.magic));
+    header.version = HEAT_GRID_VERSION;
+    header.elem_size = (uint32_t)elem_size;
+    header.rows = (uint64_t)rows;
+    header.cols = (uint64_t)cols;
+    return header;
+}
+
+inline bool grid_elem_size_valid(uint32_t elem_size) {
+    return elem_size == sizeof(double) || elem_size == sizeof(float);
+}
+
+// Reads and validates the header at the start of `file`.
+inline bool read_grid_header(FILE* file, HeatGridHeader& header) {
+    if (fread(&header, sizeof(header), 1, file) != 1) return false;
+    return memcmp(header.magic, HEAT_GRID_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == HEAT_GRID_VERSION && grid_elem_size_valid(header.elem_size);
+}
+
+// Writes a rows x cols grid given by row pointers. Returns false on I/O error.
+template <typename T>
+inline bool write_grid_binary(const char* filename, T* const* grid, int rows, int cols) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) return false;
+    HeatGridHeader header = make_grid_header(rows, cols, sizeof(T));
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < rows; ++i) {
+        ok = fwrite(grid[i], sizeof(T), cols, file) == (size_t)cols;
+    }
+    return fclose(file) == 0 && ok;
+}
+
+// Reads a grid written by write_grid_binary<T> into row pointers. Returns
+// false if the file is missing or unreadable, or holds another size or
+// element type.
+template <typename T>
+inline bool read_grid_binary(const char* filename, T* const* grid, int rows, int cols) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return false;
+    HeatGridHeader header;
+    bool ok = read_grid_header(file, header) && header.elem_size == sizeof(T) &&
+              header.rows == (uint64_t)rows && header.cols == (uint64_t)cols;
+    for (int i = 0; ok && i < rows; ++i) {
+        ok = fread(grid[i], sizeof(T), cols, file) == (size_t)cols;
+    }
+    fclose(file);
+    return ok;
+}
+
+// Streams a binary grid file into the text format ("rows cols" line, then
+// one space-separated line per row with 6 significant digits, as
+// std::ostream prints doubles). Returns false on I/O or format error.
+inline bool convert_grid_binary_to_text(const char* binary_filename, const char* text_filename) {
+    FILE* in = fopen(binary_filename, "rb");
+    if (!in) return false;
+    HeatGridHeader header;
+    if (!read_grid_header(in, header)) {
+        fclose(in);
+        return false;
+    }
+    FILE* out = fopen(text_filename, "w");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+    std::vector<char> row(header.cols * header.elem_size);
+    bool ok = fprintf(out, "%llu %llu\n", (unsigned long long)header.rows, (unsigned long long)header.cols) > 0;
+    for (uint64_t i = 0; ok && i < header.rows; ++i) {
+        ok = fread(row.data(), header.elem_size, header.cols, in) == header.cols;
+        for (uint64_t j = 0; ok && j < header.cols; ++j) {
+            double value = header.elem_size == sizeof(float) ? (double)((const float*)row.data())[j]
+                                                             : ((const double*)row.data())[j];
+            fprintf(out, j + 1 == header.cols ? "%g" : "%g ", value);
+        }
+        fputc('\n', out);
+    }
+    fclose(in);
+    return fclose(out) == 0 && ok;
+}
+
+// Checkpoint file: this header followed by the global grid (rows x cols
+// elements of elem_size, row-major) at iteration `iteration`. The grid is stored in global
+// layout, so a run can restart on any number of ranks. Version 2 added the
+// time step, scheme and precision, so a restart continues the same run.
+#define HEAT_CHECKPOINT_MAGIC "HEATCKP1"
+#define HEAT_CHECKPOINT_VERSION 2
+
+enum HeatCheckpointScheme {
+    HEAT_SCHEME_EXPLICIT, // Explicit stencil
+    HEAT_SCHEME_ADI       // Peaceman-Rachford ADI (--adi)
+};
+
+struct HeatCheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t elem_size;
+    uint64_t rows;
+    uint64_t cols;
+    int64_t iteration;    // Time steps completed
+    int32_t n_global;     // Parameters needed to continue the run
+    int32_t max_iterations;
+    double c_const;
+    double boundary_top;
+    double boundary_bottom;
+    double boundary_left;
+    double boundary_right;
+    double dt;
+    int32_t scheme;       // HeatCheckpointScheme
+    int32_t precision;    // HeatPrecision
+};
+
+inline bool checkpoint_header_valid(const HeatCheckpointHeader& header) {
+    return memcmp(header.magic, HEAT_CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == HEAT_CHECKPOINT_VERSION && grid_elem_size_valid(header.elem_size) &&
+           header.rows == header.cols && header.rows == (uint64_t)header.n_global + 2;
+}
+
+#endif // HEAT_IO_H
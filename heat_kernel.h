@@ -0,0 +1,366 @@
+#ifndef HEAT_KERNEL_H
+#define HEAT_KERNEL_H
+
+// 5-point stencil kernel shared by the serial and MPI solvers.
+//
+//   out[i][j] = u[i][j] + coef * (u[i+1][j] + u[i-1][j] + u[i][j+1] + u[i][j-1] - 4 u[i][j])
+//
+// with coef = c * dt / ds^2 hoisted out of the loop. The row kernel has scalar,
+// SSE2, AVX2 and AVX-512 versions; the widest one the CPU supports is picked at
+// runtime (HEAT_SIMD=scalar|sse2|avx2|avx512 overrides the choice). All versions
+// evaluate the expression in the same order without FMA contraction, so they
+// produce bit-identical results.
+//
+// Kernels and grids are templated on the storage type T and the accumulation
+// type Acc the expression is evaluated in: <double, double>, <float, float>,
+// or the mixed <float, double>, which stores floats (half the memory traffic)
+// but computes each update in double.
+//
+// Built with OpenMP (-fopenmp), large regions are split by rows over a static
+// thread team; a region updated from inside a team runs on the calling thread.
+// Grids are not touched at allocation time: callers initialize them with the
+// row split of heat_owned_rows, so on NUMA machines each page is first touched,
+// and therefore placed, on the node of the thread that owns its rows. Sweeps
+// over a whole grid split the rows almost the same way, and the MPI solver's
+// overlapped interior uses heat_owned_rows itself. Temporally tiled sweeps
+// (heat_tiling.h) hand whole tiles to threads instead, so their accesses are
+// not node-local.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HEAT_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define HEAT_GRID_ALIGNMENT 64 // Bytes; one cache line / one AVX-512 vector
+#define HEAT_PARALLEL_MIN_POINTS 32768 // Smaller regions are not worth a fork/join
+
+// Sets the size of the thread team (n <= 0 keeps OMP_NUM_THREADS / the default).
+inline void heat_set_num_threads(int n) {
+#ifdef _OPENMP
+    if (n > 0) omp_set_num_threads(n);
+#else
+    (void)n;
+#endif
+}
+
+inline int heat_num_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Thread number of the caller within its team, and the size of that team.
+inline int heat_thread_num() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int heat_team_size() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// True inside a parallel region, where a region update stays on the calling thread.
+inline bool heat_in_parallel() {
+#ifdef _OPENMP
+    return omp_in_parallel() != 0;
+#else
+    return false;
+#endif
+}
+
+// Rows [begin, end] of 0 .. rows - 1 owned by thread `thread` of `threads`:
+// contiguous blocks, the first rows % threads of them one row longer.
+inline void heat_owned_rows(int rows, int thread, int threads, int& begin, int& end) {
+    int base = rows / threads, extra = rows % threads;
+    begin = thread * base + (thread < extra ? thread : extra);
+    end = begin + base + (thread < extra ? 1 : 0) - 1;
+}
+
+// Precision of a run (--precision): storage type / accumulation type.
+enum HeatPrecision {
+    HEAT_PRECISION_DOUBLE, // <double, double>
+    HEAT_PRECISION_FLOAT,  // <float, float>
+    HEAT_PRECISION_MIXED   // <float, double>: float grids and messages, double arithmetic
+};
+
+inline bool parse_heat_precision(const char* name, HeatPrecision& precision) {
+    if (strcmp(name, "double") == 0) precision = HEAT_PRECISION_DOUBLE;
+    else if (strcmp(name, "float") == 0) precision = HEAT_PRECISION_FLOAT;
+    else if (strcmp(name, "mixed") == 0) precision = HEAT_PRECISION_MIXED;
+    else return false;
+    return true;
+}
+
+inline const char* heat_precision_name(HeatPrecision precision) {
+    return precision == HEAT_PRECISION_FLOAT ? "float" : precision == HEAT_PRECISION_MIXED ? "mixed" : "double";
+}
+
+inline size_t heat_precision_elem_size(HeatPrecision precision) {
+    return precision == HEAT_PRECISION_DOUBLE ? sizeof(double) : sizeof(float);
+}
+
+// Row length in elements of an aligned grid with `cols` columns.
+inline int aligned_grid_stride(int cols, size_t elem_size = sizeof(double)) {
+    const int per_line = HEAT_GRID_ALIGNMENT / (int)elem_size;
+    return (cols + per_line - 1) / per_line * per_line;
+}
+
+// Allocates a rows x cols grid as one 64-byte aligned block. Each row is padded
+// to a multiple of 64 bytes so every row starts aligned. Returns row pointers
+// like allocate_2d_array (free with free_aligned_grid); *stride receives the
+// padded row length in elements. The block is left untouched (see first-touch
+// note above); every cell a kernel reads must be initialized by the caller.
+template <typename T = double>
+inline T** allocate_aligned_grid(int rows, int cols, int* stride) {
+    int padded_cols = aligned_grid_stride(cols, sizeof(T));
+    size_t bytes = (size_t)rows * padded_cols * sizeof(T);
+    void* data = NULL;
+    if (posix_memalign(&data, HEAT_GRID_ALIGNMENT, bytes > 0 ? bytes : HEAT_GRID_ALIGNMENT) != 0) return NULL;
+    T** array = (T**)malloc(rows * sizeof(T*));
+    if (!array) {
+        free(data);
+        return NULL;
+    }
+    for (int i = 0; i < rows; i++) {
+        array[i] = (T*)data + (size_t)i * padded_cols;
+    }
+    if (stride) *stride = padded_cols;
+    return array;
+}
+
+template <typename T>
+inline void free_aligned_grid(T** array) {
+    if (array) {
+        if (array[0]) free(array[0]); // Free the aligned block
+        free(array); // Free the row pointers
+    }
+}
+
+// Size in bytes of the level-2 or level-3 data cache, with a conservative
+// fallback when the system does not report it.
+inline size_t heat_cache_size(int level) {
+    long bytes = -1;
+#if defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+    bytes = sysconf(level >= 3 ? _SC_LEVEL3_CACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+    if (bytes <= 0 && level >= 3) bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (bytes <= 0) bytes = level >= 3 ? 8L * 1024 * 1024 : 256L * 1024;
+    return (size_t)bytes;
+}
+
+// Non-temporal stores only pay off when the two time levels do not fit in the
+// last-level cache; otherwise the next step would re-read from DRAM what a
+// normal store would have left in cache.
+inline bool stencil_use_streaming(size_t bytes_per_grid) {
+    return 2 * bytes_per_grid > heat_cache_size(3);
+}
+
+// Updates out[j] for j in [j_begin, j_end] from the rows above, at and below.
+template <typename T>
+using StencilRowKernelT = void (*)(const T* up, const T* row, const T* down,
+                                   T* out, int j_begin, int j_end, double coef, bool stream);
+typedef StencilRowKernelT<double> StencilRowKernel;
+
+template <typename T, typename Acc>
+inline T stencil_point(const T* up, const T* row, const T* down, int j, double coef) {
+    Acc m = row[j];
+    return (T)(m + (Acc)coef * ((Acc)down[j] + (Acc)up[j] + (Acc)row[j + 1] + (Acc)row[j - 1] - (Acc)4.0 * m));
+}
+
+template <typename T, typename Acc>
+inline void stencil_row_scalar(const T* up, const T* row, const T* down,
+                               T* out, int j_begin, int j_end, double coef, bool) {
+    for (int j = j_begin; j <= j_end; ++j) {
+        out[j] = stencil_point<T, Acc>(up, row, down, j, coef);
+    }
+}
+
+#ifdef HEAT_KERNEL_X86
+
+// Mixed precision: WIDTH floats are widened to a vector of doubles on load and
+// narrowed back on store. SSE2 has no 8-byte non-temporal float store, so its
+// "stream" store is a normal one. The AVX-512 conversions use the all-ones
+// maskz forms, which avoid a GCC 12 -Wmaybe-uninitialized false positive.
+__attribute__((target("sse2"))) inline __m128d heat_load2_ps_pd(const float* p) {
+    return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double*)p)));
+}
+__attribute__((target("sse2"))) inline void heat_store2_pd_ps(float* p, __m128d v) {
+    _mm_store_sd((double*)p, _mm_castps_pd(_mm_cvtpd_ps(v)));
+}
+__attribute__((target("avx2"))) inline __m256d heat_load4_ps_pd(const float* p) {
+    return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+__attribute__((target("avx2"))) inline void heat_store4_pd_ps(float* p, __m256d v) {
+    _mm_storeu_ps(p, _mm256_cvtpd_ps(v));
+}
+__attribute__((target("avx2"))) inline void heat_stream4_pd_ps(float* p, __m256d v) {
+    _mm_stream_ps(p, _mm256_cvtpd_ps(v));
+}
+__attribute__((target("avx512f"))) inline __m512d heat_load8_ps_pd(const float* p) {
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(p));
+}
+__attribute__((target("avx512f"))) inline void heat_store8_pd_ps(float* p, __m512d v) {
+    _mm256_storeu_ps(p, _mm512_maskz_cvtpd_ps(0xFF, v));
+}
+__attribute__((target("avx512f"))) inline void heat_stream8_pd_ps(float* p, __m512d v) {
+    _mm256_stream_ps(p, _mm512_maskz_cvtpd_ps(0xFF, v));
+}
+
+// Each vector version peels scalar points until out + j is aligned when
+// streaming (non-temporal stores need aligned addresses), runs full vectors,
+// and finishes the tail with scalar points.
+#define HEAT_DEFINE_ROW_KERNEL(NAME, TARGET, T, ACC, VEC, WIDTH, SET1, LOADU, STOREU, STREAM, ADD, SUB, MUL) \
+    __attribute__((target(TARGET), optimize("fp-contract=off")))                                 \
+    inline void NAME(const T* up, const T* row, const T* down,                                    \
+                     T* out, int j_begin, int j_end, double coef, bool stream) {                  \
+        int j = j_begin;                                                                          \
+        const VEC c = SET1((ACC)coef);                                                            \
+        const VEC four = SET1((ACC)4.0);                                                          \
+        if (stream) {                                                                             \
+            for (; j <= j_end && ((uintptr_t)(out + j) % (WIDTH * sizeof(T))) != 0; ++j) {        \
+                out[j] = stencil_point<T, ACC>(up, row, down, j, coef);                           \
+            }                                                                                     \
+            for (; j + WIDTH - 1 <= j_end; j += WIDTH) {                                          \
+                VEC m = LOADU(row + j);                                                           \
+                VEC s = ADD(LOADU(down + j), LOADU(up + j));                                      \
+                s = ADD(s, LOADU(row + j + 1));                                                   \
+                s = ADD(s, LOADU(row + j - 1));                                                   \
+                s = SUB(s, MUL(four, m));                                                         \
+                STREAM(out + j, ADD(m, MUL(c, s)));                                               \
+            }                                                                                     \
+            _mm_sfence();                                                                         \
+        } else {                                                                                  \
+            for (; j + WIDTH - 1 <= j_end; j += WIDTH) {                                          \
+                VEC m = LOADU(row + j);                                                           \
+                VEC s = ADD(LOADU(down + j), LOADU(up + j));                                      \
+                s = ADD(s, LOADU(row + j + 1));                                                   \
+                s = ADD(s, LOADU(row + j - 1));                                                   \
+                s = SUB(s, MUL(four, m));                                                         \
+                STOREU(out + j, ADD(m, MUL(c, s)));                                               \
+            }                                                                                     \
+        }                                                                                         \
+        for (; j <= j_end; ++j) {                                                                 \
+            out[j] = stencil_point<T, ACC>(up, row, down, j, coef);                               \
+        }                                                                                         \
+    }
+
+HEAT_DEFINE_ROW_KERNEL(stencil_row_sse2, "sse2", double, double, __m128d, 2, _mm_set1_pd, _mm_loadu_pd,
+                       _mm_storeu_pd, _mm_stream_pd, _mm_add_pd, _mm_sub_pd, _mm_mul_pd)
+HEAT_DEFINE_ROW_KERNEL(stencil_row_avx2, "avx2", double, double, __m256d, 4, _mm256_set1_pd, _mm256_loadu_pd,
+                       _mm256_storeu_pd, _mm256_stream_pd, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd)
+HEAT_DEFINE_ROW_KERNEL(stencil_row_avx512, "avx512f", double, double, __m512d, 8, _mm512_set1_pd, _mm512_loadu_pd,
+                       _mm512_storeu_pd, _mm512_stream_pd, _mm512_add_pd, _mm512_sub_pd, _mm512_mul_pd)
+
+HEAT_DEFINE_ROW_KERNEL(stencil_row_sse2_f32, "sse2", float, float, __m128, 4, _mm_set1_ps, _mm_loadu_ps,
+                       _mm_storeu_ps, _mm_stream_ps, _mm_add_ps, _mm_sub_ps, _mm_mul_ps)
+HEAT_DEFINE_ROW_KERNEL(stencil_row_avx2_f32, "avx2", float, float, __m256, 8, _mm256_set1_ps, _mm256_loadu_ps,
+                       _mm256_storeu_ps, _mm256_stream_ps, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps)
+HEAT_DEFINE_ROW_KERNEL(stencil_row_avx512_f32, "avx512f", float, float, __m512, 16, _mm512_set1_ps, _mm512_loadu_ps,
+                       _mm512_storeu_ps, _mm512_stream_ps, _mm512_add_ps, _mm512_sub_ps, _mm512_mul_ps)
+
+HEAT_DEFINE_ROW_KERNEL(stencil_row_sse2_mixed, "sse2", float, double, __m128d, 2, _mm_set1_pd, heat_load2_ps_pd,
+                       heat_store2_pd_ps, heat_store2_pd_ps, _mm_add_pd, _mm_sub_pd, _mm_mul_pd)
+HEAT_DEFINE_ROW_KERNEL(stencil_row_avx2_mixed, "avx2", float, double, __m256d, 4, _mm256_set1_pd, heat_load4_ps_pd,
+                       heat_store4_pd_ps, heat_stream4_pd_ps, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd)
+HEAT_DEFINE_ROW_KERNEL(stencil_row_avx512_mixed, "avx512f", float, double, __m512d, 8, _mm512_set1_pd,
+                       heat_load8_ps_pd, heat_store8_pd_ps, heat_stream8_pd_ps, _mm512_add_pd, _mm512_sub_pd,
+                       _mm512_mul_pd)
+
+#undef HEAT_DEFINE_ROW_KERNEL
+
+#endif // HEAT_KERNEL_X86
+
+// Row kernels of one precision, NULL where the ISA is not compiled in.
+template <typename T>
+struct StencilRowKernelSet {
+    StencilRowKernelT<T> scalar, sse2, avx2, avx512;
+};
+
+template <typename T, typename Acc>
+inline StencilRowKernelSet<T> stencil_row_kernel_set();
+
+#ifdef HEAT_KERNEL_X86
+#define HEAT_ROW_KERNEL_SET(T, ACC, SSE2, AVX2, AVX512) \
+    template <> inline StencilRowKernelSet<T> stencil_row_kernel_set<T, ACC>() { \
+        StencilRowKernelSet<T> set = {stencil_row_scalar<T, ACC>, SSE2, AVX2, AVX512}; \
+        return set; \
+    }
+#else
+#define HEAT_ROW_KERNEL_SET(T, ACC, SSE2, AVX2, AVX512) \
+    template <> inline StencilRowKernelSet<T> stencil_row_kernel_set<T, ACC>() { \
+        StencilRowKernelSet<T> set = {stencil_row_scalar<T, ACC>, NULL, NULL, NULL}; \
+        return set; \
+    }
+#endif
+
+HEAT_ROW_KERNEL_SET(double, double, stencil_row_sse2, stencil_row_avx2, stencil_row_avx512)
+HEAT_ROW_KERNEL_SET(float, float, stencil_row_sse2_f32, stencil_row_avx2_f32, stencil_row_avx512_f32)
+HEAT_ROW_KERNEL_SET(float, double, stencil_row_sse2_mixed, stencil_row_avx2_mixed, stencil_row_avx512_mixed)
+
+#undef HEAT_ROW_KERNEL_SET
+
+// Picks the row kernel once per process and precision. *name (optional)
+// receives the ISA used.
+template <typename T = double, typename Acc = T>
+inline StencilRowKernelT<T> stencil_row_kernel(const char** name = NULL) {
+    static StencilRowKernelT<T> kernel = NULL;
+    static const char* kernel_name = "scalar";
+    if (!kernel) {
+        const char* request = getenv("HEAT_SIMD");
+        StencilRowKernelSet<T> set = stencil_row_kernel_set<T, Acc>();
+        kernel = set.scalar;
+#ifdef HEAT_KERNEL_X86
+        __builtin_cpu_init();
+        bool any = !request || !request[0];
+        if ((any || strcmp(request, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+            kernel = set.avx512;
+            kernel_name = "avx512";
+        } else if ((any || strcmp(request, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+            kernel = set.avx2;
+            kernel_name = "avx2";
+        } else if ((any || strcmp(request, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+            kernel = set.sse2;
+            kernel_name = "sse2";
+        }
+#else
+        (void)request;
+#endif
+    }
+    if (name) *name = kernel_name;
+    return kernel;
+}
+
+// Updates rows [i_begin, i_end] x columns [j_begin, j_end] (inclusive) of dst from src.
+template <typename T, typename Acc = T>
+inline void stencil_region(T* const* src, T* const* dst,
+                           int i_begin, int i_end, int j_begin, int j_end, double coef, bool stream) {
+    if (i_begin > i_end || j_begin > j_end) return;
+    StencilRowKernelT<T> kernel = stencil_row_kernel<T, Acc>();
+    long points = (long)(i_end - i_begin + 1) * (j_end - j_begin + 1);
+    (void)points;
+    #pragma omp parallel for schedule(static) if (points >= HEAT_PARALLEL_MIN_POINTS && !heat_in_parallel())
+    for (int i = i_begin; i <= i_end; ++i) {
+        kernel(src[i - 1], src[i], src[i + 1], dst[i], j_begin, j_end, coef, stream);
+    }
+}
+
+#endif // HEAT_KERNEL_H
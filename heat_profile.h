@@ -0,0 +1,210 @@
+#ifndef HEAT_PROFILE_H
+#define HEAT_PROFILE_H
+
+// Per-phase timing for the solvers, enabled by building with -DHEAT_PROFILE.
+// Without it HEAT_PROFILE_SCOPE expands to nothing and nothing here is compiled.
+//
+// HEAT_PROFILE_SCOPE(HEAT_PHASE_X) times the rest of the enclosing block and
+// adds it to phase X. Scopes are not meant to nest: a nested scope's time also
+// counts in the outer one. Timing is done on the calling (main) thread, so an
+// OpenMP region inside a scope is measured by its wall time.
+//
+// Runtime switches (environment):
+//   HEAT_PROFILE_TRACE=FILE   also record every scope as a Chrome trace event
+//                             (open FILE in chrome://tracing or Perfetto)
+//   HEAT_PROFILE_COUNTERS=1   count cycles, instructions and last-level cache
+//                             misses per phase through perf_event_open (main
+//                             thread only; silently skipped when unavailable)
+
+#ifdef HEAT_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+enum HeatPhase {
+    HEAT_PHASE_COMPUTE,        // Stencil updates between halo exchanges (overlapped or not)
+    HEAT_PHASE_COMPUTE_TILED,  // Communication-free steps run by the tiled engine
+    HEAT_PHASE_HALO_POST,      // Posting halo sends/receives (derived-type packing)
+    HEAT_PHASE_HALO_WAIT,      // Waiting for and progressing halo messages
+    HEAT_PHASE_SOR_SWEEP,      // Red-black SOR half-sweeps
+    HEAT_PHASE_ADI_SOLVE,      // ADI tridiagonal line solves
+    HEAT_PHASE_ADI_TRANSPOSE,  // ADI line redistribution (MPI_Alltoallv)
+    HEAT_PHASE_REDUCE,         // Residual reductions
+    HEAT_PHASE_CHECKPOINT,     // Staging and completing checkpoint writes
+    HEAT_PHASE_SNAPSHOT,       // Staging snapshots, and waiting for the I/O thread when it falls behind
+    HEAT_PHASE_BARRIER,        // Waiting for the slowest rank at the end of the run
+    HEAT_PHASE_OUTPUT,         // Writing the final grid
+    HEAT_PHASE_COUNT
+};
+
+static const char* const heat_phase_names[HEAT_PHASE_COUNT] = {
+    "compute", "compute_tiled", "halo_post", "halo_wait", "sor_sweep",
+    "adi_solve", "adi_transpose", "reduce", "checkpoint", "snapshot", "barrier", "output",
+};
+
+#define HEAT_PROFILE_NUM_COUNTERS 3  // cycles, instructions, LLC misses
+#define HEAT_PROFILE_MAX_EVENTS (1 << 20) // Trace events kept per process
+
+struct HeatPhaseStats {
+    double seconds;
+    long calls;
+    uint64_t counters[HEAT_PROFILE_NUM_COUNTERS];
+};
+
+struct HeatTraceEvent {
+    int phase;
+    double start;     // Seconds since heat_profile_init
+    double duration;
+};
+
+struct HeatProfiler {
+    HeatPhaseStats phases[HEAT_PHASE_COUNT];
+    double t0;
+    const char* trace_file;            // NULL = no trace
+    std::vector<HeatTraceEvent> events;
+    long dropped_events;
+    int counter_fd;                    // perf event group leader (-1 = no counters)
+};
+
+inline HeatProfiler& heat_profiler() {
+    static HeatProfiler profiler = {{}, 0.0, NULL, std::vector<HeatTraceEvent>(), 0, -1};
+    return profiler;
+}
+
+inline double heat_profile_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// Reads the counter group into values; returns false if counters are off.
+inline bool heat_profile_read_counters(uint64_t* values) {
+#ifdef __linux__
+    HeatProfiler& p = heat_profiler();
+    if (p.counter_fd < 0) return false;
+    uint64_t buffer[1 + HEAT_PROFILE_NUM_COUNTERS];
+    if (read(p.counter_fd, buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer)) return false;
+    memcpy(values, buffer + 1, sizeof(uint64_t) * HEAT_PROFILE_NUM_COUNTERS);
+    return true;
+#else
+    (void)values;
+    return false;
+#endif
+}
+
+#ifdef __linux__
+inline int heat_profile_open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group_fd < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+// Starts the clock and applies the environment switches. Call once, early.
+inline void heat_profile_init() {
+    HeatProfiler& p = heat_profiler();
+    p.t0 = heat_profile_clock();
+    const char* trace = getenv("HEAT_PROFILE_TRACE");
+    p.trace_file = trace && trace[0] ? trace : NULL;
+    if (p.trace_file) p.events.reserve(4096);
+#ifdef __linux__
+    const char* counters = getenv("HEAT_PROFILE_COUNTERS");
+    if (counters && atoi(counters) > 0) {
+        const uint64_t configs[HEAT_PROFILE_NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+        int leader = heat_profile_open_counter(configs[0], -1);
+        bool ok = leader >= 0;
+        for (int c = 1; ok && c < HEAT_PROFILE_NUM_COUNTERS; ++c) {
+            ok = heat_profile_open_counter(configs[c], leader) >= 0;
+        }
+        if (ok) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            p.counter_fd = leader;
+        } else if (leader >= 0) {
+            close(leader); // Members that did open close with the process
+        }
+    }
+#endif
+}
+
+// Discards the phases measured so far (e.g. autotuning probes); the counters
+// and the trace clock keep running.
+inline void heat_profile_reset() {
+    HeatProfiler& p = heat_profiler();
+    memset(p.phases, 0, sizeof(p.phases));
+    p.events.clear();
+    p.dropped_events = 0;
+}
+
+class HeatProfileScope {
+public:
+    explicit HeatProfileScope(HeatPhase phase) : phase_(phase) {
+        has_counters_ = heat_profile_read_counters(counters_);
+        start_ = heat_profile_clock();
+    }
+    ~HeatProfileScope() {
+        double end = heat_profile_clock();
+        HeatProfiler& p = heat_profiler();
+        HeatPhaseStats& stats = p.phases[phase_];
+        stats.seconds += end - start_;
+        stats.calls++;
+        uint64_t now[HEAT_PROFILE_NUM_COUNTERS];
+        if (has_counters_ && heat_profile_read_counters(now)) {
+            for (int c = 0; c < HEAT_PROFILE_NUM_COUNTERS; ++c) stats.counters[c] += now[c] - counters_[c];
+        }
+        if (p.trace_file) {
+            if (p.events.size() < HEAT_PROFILE_MAX_EVENTS) {
+                HeatTraceEvent event = {phase_, start_ - p.t0, end - start_};
+                p.events.push_back(event);
+            } else {
+                p.dropped_events++;
+            }
+        }
+    }
+
+private:
+    HeatPhase phase_;
+    double start_;
+    bool has_counters_;
+    uint64_t counters_[HEAT_PROFILE_NUM_COUNTERS];
+};
+
+#define HEAT_PROFILE_CONCAT2(a, b) a##b
+#define HEAT_PROFILE_CONCAT(a, b) HEAT_PROFILE_CONCAT2(a, b)
+#define HEAT_PROFILE_SCOPE(phase) HeatProfileScope HEAT_PROFILE_CONCAT(heat_profile_scope_, __LINE__)(phase)
+
+// Appends this process's events to an open Chrome trace ("X" complete events;
+// pid = rank). `first` tells whether a comma is needed before the first event.
+inline void heat_profile_write_trace_events(FILE* file, int rank, const HeatTraceEvent* events, long count, bool first) {
+    for (long e = 0; e < count; ++e) {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+                first && e == 0 ? "\n" : ",\n", heat_phase_names[events[e].phase], rank,
+                1e6 * events[e].start, 1e6 * events[e].duration);
+    }
+}
+
+#else // !HEAT_PROFILE
+
+#define HEAT_PROFILE_SCOPE(phase) ((void)0)
+
+#endif // HEAT_PROFILE
+
+#endif // HEAT_PROFILE_H
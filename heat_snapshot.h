@@ -0,0 +1,171 @@
+#ifndef HEAT_SNAPSHOT_H
+#define HEAT_SNAPSHOT_H
+
+// In-situ snapshots (--snapshot-every K): the grid, or a downsampled region of
+// it, written every K steps to a sequence of binary grid files (heat_io.h
+// format, so compare_outputs and the text converter read them) while the run
+// continues.
+//
+// Each rank copies the snapshot cells it owns into one of two staging slots
+// and hands the slot to a background I/O thread, which pwrite()s the rows at
+// their offsets in the shared file. With two slots the time loop only waits
+// when the disk falls more than a whole snapshot behind; otherwise its cost
+// is the staging copy. The I/O thread makes no MPI calls, so MPI stays
+// funneled through the main thread; the solver agrees on completed files
+// itself.
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "heat_io.h"
+
+// Snapshot cell (a, b) is global cell (row0 + a * stride, col0 + b * stride).
+struct SnapshotLayout {
+    int row0, col0;       // First global cell
+    int rows, cols;       // Snapshot size in cells
+    int stride;           // Downsampling factor (1 = every cell)
+};
+
+// Snapshot indices [first, first + count) of one dimension whose global index
+// lies in [begin, end).
+inline void snapshot_owned_range(int origin, int stride, int size, int begin, int end, int& first, int& count) {
+    int lo = begin <= origin ? 0 : (begin - origin + stride - 1) / stride;
+    int hi = end <= origin ? 0 : (end - origin + stride - 1) / stride;
+    if (hi > size) hi = size;
+    first = lo;
+    count = hi > lo ? hi - lo : 0;
+}
+
+enum SnapshotSlotState {
+    SNAPSHOT_SLOT_FREE,    // Ready to be staged into
+    SNAPSHOT_SLOT_QUEUED,  // Owned by the I/O thread
+    SNAPSHOT_SLOT_WRITTEN  // Written, outcome not yet collected
+};
+
+struct SnapshotSlot {
+    SnapshotSlotState state;
+    int iteration;
+    std::string path;         // File this rank writes its part of
+    std::vector<char> data;   // row_count rows of col_count elements, back to back
+    uint32_t elem_size;
+    int rows, cols;           // Whole snapshot
+    int first_row, row_count; // Part staged here
+    int first_col, col_count;
+    bool write_header;        // Write the header and size the file (one rank per snapshot)
+    bool ok;                  // Outcome of the write
+};
+
+struct SnapshotWriter {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    SnapshotSlot slots[2];    // Snapshot s uses slots[s % 2]
+    long long submitted;      // Snapshots handed to the thread
+    long long collected;      // Snapshots whose outcome was collected
+    bool stop;
+    double write_seconds;     // Time the I/O thread spent writing
+};
+
+inline bool snapshot_write_slot(const SnapshotSlot& slot) {
+    if (!slot.write_header && (slot.row_count == 0 || slot.col_count == 0)) return true;
+    int fd = open(slot.path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return false;
+    const off_t data_offset = sizeof(HeatGridHeader);
+    bool ok = true;
+    if (slot.write_header) {
+        // Other ranks may already have written their rows; setting the final size never clobbers them
+        HeatGridHeader header = make_grid_header(slot.rows, slot.cols, slot.elem_size);
+        ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+             ftruncate(fd, data_offset + (off_t)slot.rows * slot.cols * slot.elem_size) == 0;
+    }
+    size_t row_bytes = (size_t)slot.col_count * slot.elem_size;
+    for (int a = 0; ok && a < slot.row_count; ++a) {
+        off_t offset = data_offset + ((off_t)(slot.first_row + a) * slot.cols + slot.first_col) * slot.elem_size;
+        ok = pwrite(fd, &slot.data[a * row_bytes], row_bytes, offset) == (ssize_t)row_bytes;
+    }
+    return close(fd) == 0 && ok;
+}
+
+// I/O thread: writes queued slots oldest first until stopped with nothing queued.
+inline void snapshot_thread_main(SnapshotWriter* writer) {
+    std::unique_lock<std::mutex> lock(writer->mutex);
+    for (long long next = 0;;) {
+        SnapshotSlot& slot = writer->slots[next % 2];
+        if (next >= writer->submitted || slot.state != SNAPSHOT_SLOT_QUEUED) {
+            if (writer->stop) return;
+            writer->changed.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool ok = snapshot_write_slot(slot);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+        slot.ok = ok;
+        slot.state = SNAPSHOT_SLOT_WRITTEN;
+        writer->write_seconds += seconds;
+        ++next;
+        writer->changed.notify_all();
+    }
+}
+
+inline void snapshot_writer_start(SnapshotWriter& writer) {
+    for (int k = 0; k < 2; ++k) writer.slots[k].state = SNAPSHOT_SLOT_FREE;
+    writer.submitted = writer.collected = 0;
+    writer.stop = false;
+    writer.write_seconds = 0.0;
+    writer.thread = std::thread(snapshot_thread_main, &writer);
+}
+
+// Writes whatever is still queued, then ends the thread.
+inline void snapshot_writer_stop(SnapshotWriter& writer) {
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.stop = true;
+    }
+    writer.changed.notify_all();
+    writer.thread.join();
+}
+
+// Waits until the slot of the next snapshot is no longer being written.
+// Returns it; if it is still SNAPSHOT_SLOT_WRITTEN, its outcome has to be
+// collected before staging into it.
+inline SnapshotSlot& snapshot_wait_slot(SnapshotWriter& writer) {
+    SnapshotSlot& slot = writer.slots[writer.submitted % 2];
+    std::unique_lock<std::mutex> lock(writer.mutex);
+    writer.changed.wait(lock, [&slot] { return slot.state != SNAPSHOT_SLOT_QUEUED; });
+    return slot;
+}
+
+// Hands a staged slot (from snapshot_wait_slot) to the I/O thread.
+inline void snapshot_submit(SnapshotWriter& writer, SnapshotSlot& slot) {
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        slot.state = SNAPSHOT_SLOT_QUEUED;
+        ++writer.submitted;
+    }
+    writer.changed.notify_all();
+}
+
+// Collects the outcome of the oldest uncollected snapshot if it has been
+// written (false otherwise) and frees its slot. Outcomes come in submission order.
+inline bool snapshot_collect(SnapshotWriter& writer, int& iteration, bool& ok) {
+    std::lock_guard<std::mutex> lock(writer.mutex);
+    if (writer.collected == writer.submitted) return false;
+    SnapshotSlot& slot = writer.slots[writer.collected % 2];
+    if (slot.state != SNAPSHOT_SLOT_WRITTEN) return false;
+    iteration = slot.iteration;
+    ok = slot.ok;
+    slot.state = SNAPSHOT_SLOT_FREE;
+    ++writer.collected;
+    return true;
+}
+
+#endif // HEAT_SNAPSHOT_H
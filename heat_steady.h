@@ -0,0 +1,55 @@
+#ifndef HEAT_STEADY_H
+#define HEAT_STEADY_H
+
+// Red-black successive over-relaxation for the steady-state (Laplace) problem,
+// shared by the serial and MPI solvers' --steady mode.
+//
+// A sweep relaxes all "red" cells ((i + j) even in global indices) and then
+// all "black" cells. Cells of one color only read cells of the other color, so
+// each half-sweep is order-independent: it can be split over threads and MPI
+// blocks and still give exactly the same result as the serial sweep.
+
+#include <math.h>
+#include "heat_kernel.h"
+
+// Over-relaxation factor that is optimal for the 5-point Laplacian on a square
+// grid with n inner points per side.
+inline double sor_optimal_omega(int n) {
+    return 2.0 / (1.0 + sin(M_PI / (n + 1)));
+}
+
+// Relaxes the cells of one color in rows [i_begin, i_end] x columns
+// [j_begin, j_end]. `parity` is (global row + global column) of local cell
+// (0, 0), so colors agree across blocks. Returns the largest Gauss-Seidel
+// correction |avg - u| seen when track_residual is set, else 0. Cells are
+// stored as T and relaxed in Acc arithmetic (see heat_kernel.h).
+template <typename T, typename Acc = T>
+inline double sor_sweep_color(T* const* u, int i_begin, int i_end, int j_begin, int j_end,
+                              int color, int parity, double omega, bool track_residual) {
+    double residual = 0.0;
+    if (i_begin > i_end || j_begin > j_end) return residual;
+    long points = (long)(i_end - i_begin + 1) * (j_end - j_begin + 1);
+    (void)points;
+    #pragma omp parallel for schedule(static) reduction(max:residual) if (points >= HEAT_PARALLEL_MIN_POINTS)
+    for (int i = i_begin; i <= i_end; ++i) {
+        T* up = u[i - 1];
+        T* row = u[i];
+        T* down = u[i + 1];
+        const Acc w = (Acc)omega;
+        int j = j_begin + (((i + j_begin + parity + color) % 2) + 2) % 2;
+        if (track_residual) {
+            for (; j <= j_end; j += 2) {
+                Acc correction = (Acc)0.25 * ((Acc)down[j] + (Acc)up[j] + (Acc)row[j + 1] + (Acc)row[j - 1]) - (Acc)row[j];
+                row[j] = (T)((Acc)row[j] + w * correction);
+                if (fabs((double)correction) > residual) residual = fabs((double)correction);
+            }
+        } else {
+            for (; j <= j_end; j += 2) {
+                row[j] = (T)((Acc)row[j] + w * ((Acc)0.25 * ((Acc)down[j] + (Acc)up[j] + (Acc)row[j + 1] + (Acc)row[j - 1]) - (Acc)row[j]));
+            }
+        }
+    }
+    return residual;
+}
+
+#endif // HEAT_STEADY_H
@@ -0,0 +1,135 @@
+#ifndef HEAT_TILING_H
+#define HEAT_TILING_H
+
+// Cache-blocked time stepping on top of heat_kernel.h.
+//
+// A run of time steps is cut into chunks of tiling.time_steps. Within a chunk
+// the grid is covered by parallelogram tiles in the skewed coordinates
+// (i + s, j + s), s being the step within the chunk. Each tile advances through
+// every step of the chunk before the next tile starts, so its rows are reused
+// from cache instead of streaming the whole grid from DRAM once per step.
+// Visiting tiles in row-major order satisfies every dependency of the 5-point
+// stencil and never overwrites a value a later tile still reads, even with
+// only two time levels. Each cell is computed from the same inputs as in a
+// plain sweep, so results are bit-identical.
+//
+// A tile only reads cells written by itself and by the tiles above and to the
+// left of it, and the tiles of one anti-diagonal neither read nor overwrite
+// each other's cells. With more than one thread the tiles are therefore
+// advanced as a wavefront: one anti-diagonal after the other, its tiles
+// shared among the team, each tile on a single thread.
+
+#include <vector>
+#include "heat_kernel.h"
+
+struct StencilTiling {
+    int tile_rows;        // Tile height in skewed rows (0 = auto)
+    int tile_cols;        // Tile width in skewed columns (0 = auto)
+    int time_steps;       // Steps advanced per tile; 1 disables tiling (0 = auto)
+};
+
+// Fills in the sizes left at 0 so that a tile's working set, about
+// (rows + steps) x (cols + steps) points in two time levels, stays within half
+// of the L2 cache. Whole rows are kept when a tall enough tile of them fits,
+// since the row kernel vectorizes best over long rows. With a thread team the
+// tiles are made narrow enough that a row of them (the widest anti-diagonal)
+// gives every thread two, down to HEAT_TILE_MIN_COLS columns.
+#define HEAT_TILE_MIN_COLS 64
+
+inline StencilTiling stencil_auto_tiling(int grid_rows, int grid_cols, StencilTiling requested,
+                                         size_t elem_size = sizeof(double)) {
+    StencilTiling t = requested;
+    if (t.time_steps <= 0) t.time_steps = 8;
+    size_t budget_points = heat_cache_size(2) / 2 / (2 * elem_size);
+    if (t.tile_cols <= 0) {
+        size_t full_width = (size_t)grid_cols + t.time_steps;
+        t.tile_cols = full_width * 4 * t.time_steps <= budget_points ? (int)full_width : 512;
+        int threads = heat_num_threads();
+        if (threads > 1) {
+            int shared = (int)((full_width + 2 * threads - 1) / (2 * threads));
+            if (shared < HEAT_TILE_MIN_COLS) shared = HEAT_TILE_MIN_COLS;
+            if (shared < t.tile_cols) t.tile_cols = shared;
+        }
+    }
+    if (t.tile_rows <= 0) {
+        long rows = (long)(budget_points / ((size_t)t.tile_cols + t.time_steps)) - t.time_steps;
+        t.tile_rows = rows < t.time_steps ? t.time_steps : (int)rows;
+        if (t.tile_rows > grid_rows + t.time_steps) t.tile_rows = grid_rows + t.time_steps;
+    }
+    return t;
+}
+
+// Advances one tile, at skewed (tile_row, tile_col), through the `chunk`
+// steps from t0 whose regions are in bounds (see stencil_advance_tiled).
+template <typename T, typename Acc>
+void stencil_advance_tile(T** grid_a, T** grid_b, int t0, int chunk, const int* bounds, double coef,
+                          const StencilTiling& tiling, int tile_row, int tile_col) {
+    for (int s = 0; s < chunk; ++s) {
+        const int* b = &bounds[4 * s];
+        int i0 = b[0] > tile_row - s ? b[0] : tile_row - s;
+        int i1 = b[1] < tile_row + tiling.tile_rows - 1 - s ? b[1] : tile_row + tiling.tile_rows - 1 - s;
+        int j0 = b[2] > tile_col - s ? b[2] : tile_col - s;
+        int j1 = b[3] < tile_col + tiling.tile_cols - 1 - s ? b[3] : tile_col + tiling.tile_cols - 1 - s;
+        if (i0 > i1 || j0 > j1) continue;
+        bool even = (t0 + s) % 2 == 0;
+        stencil_region<T, Acc>(even ? grid_a : grid_b, even ? grid_b : grid_a, i0, i1, j0, j1, coef, false);
+    }
+}
+
+// Advances `steps` time steps starting from grid_a and alternating between the
+// two grids; the result ends up in grid_a if steps is even, else in grid_b.
+// range(s, i0, i1, j0, j1) gives the inclusive region step s (0-based) updates.
+// A step may only read cells the previous step wrote or that never change.
+// Acc is the accumulation type of the kernel (see heat_kernel.h).
+template <typename T, typename Acc, typename StepRange>
+void stencil_advance_tiled(T** grid_a, T** grid_b, int steps, double coef,
+                           const StencilTiling& tiling, StepRange range) {
+    int chunk_steps = tiling.time_steps > 0 ? tiling.time_steps : 1;
+    std::vector<int> bounds(4 * chunk_steps);
+    const bool team = heat_num_threads() > 1;
+
+    for (int t0 = 0; t0 < steps; t0 += chunk_steps) {
+        int chunk = steps - t0 < chunk_steps ? steps - t0 : chunk_steps;
+
+        // Bounding box of the chunk in skewed coordinates
+        int row_lo = 0, row_hi = -1, col_lo = 0, col_hi = -1;
+        bool any = false;
+        for (int s = 0; s < chunk; ++s) {
+            int* b = &bounds[4 * s];
+            range(t0 + s, b[0], b[1], b[2], b[3]);
+            if (b[0] > b[1] || b[2] > b[3]) continue;
+            if (!any || b[0] + s < row_lo) row_lo = b[0] + s;
+            if (!any || b[1] + s > row_hi) row_hi = b[1] + s;
+            if (!any || b[2] + s < col_lo) col_lo = b[2] + s;
+            if (!any || b[3] + s > col_hi) col_hi = b[3] + s;
+            any = true;
+        }
+        if (!any) continue;
+
+        const int tiles_down = (row_hi - row_lo) / tiling.tile_rows + 1;
+        const int tiles_across = (col_hi - col_lo) / tiling.tile_cols + 1;
+        const int* b = bounds.data();
+        if (!team || tiles_down == 1 || tiles_across == 1) {
+            // No two tiles can run at once; large tiles still split their rows
+            for (int r = 0; r < tiles_down; ++r) {
+                for (int c = 0; c < tiles_across; ++c) {
+                    stencil_advance_tile<T, Acc>(grid_a, grid_b, t0, chunk, b, coef, tiling,
+                                                 row_lo + r * tiling.tile_rows, col_lo + c * tiling.tile_cols);
+                }
+            }
+            continue;
+        }
+        #pragma omp parallel
+        for (int d = 0; d < tiles_down + tiles_across - 1; ++d) {
+            int r_first = d - tiles_across + 1 > 0 ? d - tiles_across + 1 : 0;
+            int r_last = d < tiles_down - 1 ? d : tiles_down - 1;
+            #pragma omp for schedule(dynamic, 1)
+            for (int r = r_first; r <= r_last; ++r) {
+                stencil_advance_tile<T, Acc>(grid_a, grid_b, t0, chunk, b, coef, tiling,
+                                             row_lo + r * tiling.tile_rows, col_lo + (d - r) * tiling.tile_cols);
+            }
+        }
+    }
+}
+
+#endif // HEAT_TILING_H
@@ -0,0 +1,131 @@
+#ifndef HEAT_TUNING_H
+#define HEAT_TUNING_H
+
+// Tuning database of --autotune. It maps a key (global grid size, rank count,
+// precision, host signature) to the fastest configuration the probes found,
+// so later runs with the same key start straight away with it. Plain text,
+// one entry per line:
+//
+//   n_global ranks precision host dims_rows dims_cols halo tile_rows tile_cols tile_steps threads mlups
+//
+// Tile sizes are as requested (0 = auto, see heat_tiling.h). Lines starting
+// with '#' are comments. Storing a key replaces its previous entry; the file
+// is rewritten under a temporary name and renamed, so readers never see a
+// partial database.
+//
+// The host signature names the hardware rather than the machine (CPU model,
+// logical CPUs, cache sizes, node count), so identical nodes of a cluster
+// share entries.
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include "heat_kernel.h"
+#include "heat_tiling.h"
+
+struct HeatTuningKey {
+    int n_global;
+    int ranks;
+    char precision[8];
+    char host[192];
+};
+
+struct HeatTunedConfig {
+    int dims[2];          // Process grid
+    int halo_depth;
+    StencilTiling tiling; // As requested (0 = auto)
+    int num_threads;      // OpenMP threads per rank
+    double mlups;         // Probe rate, for information
+};
+
+// Signature of this host running `nodes` nodes of it. Whitespace is replaced
+// so the signature is one database field.
+inline void heat_host_signature(char* signature, size_t size, int nodes) {
+    char model[128] = "unknown-cpu";
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo) {
+        char line[256];
+        while (fgets(line, sizeof(line), cpuinfo)) {
+            const char* colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) == 0 && colon) {
+                snprintf(model, sizeof(model), "%s", colon + 1 + strspn(colon + 1, " \t"));
+                model[strcspn(model, "\r\n")] = '\0';
+                break;
+            }
+        }
+        fclose(cpuinfo);
+    }
+    snprintf(signature, size, "%s/%ldcpu/L2-%zuK/L3-%zuK/%dnode", model, sysconf(_SC_NPROCESSORS_ONLN),
+             heat_cache_size(2) / 1024, heat_cache_size(3) / 1024, nodes);
+    for (char* c = signature; *c; ++c) {
+        if (isspace((unsigned char)*c)) *c = '_';
+    }
+}
+
+// Parses one database line; false for comments and malformed lines.
+inline bool heat_tuning_parse(const char* line, HeatTuningKey& key, HeatTunedConfig& config) {
+    if (line[strspn(line, " \t")] == '#') return false;
+    return sscanf(line, "%d %d %7s %191s %d %d %d %d %d %d %d %lf", &key.n_global, &key.ranks, key.precision,
+                  key.host, &config.dims[0], &config.dims[1], &config.halo_depth, &config.tiling.tile_rows,
+                  &config.tiling.tile_cols, &config.tiling.time_steps, &config.num_threads, &config.mlups) == 12;
+}
+
+inline bool heat_tuning_key_equal(const HeatTuningKey& a, const HeatTuningKey& b) {
+    return a.n_global == b.n_global && a.ranks == b.ranks && strcmp(a.precision, b.precision) == 0 &&
+           strcmp(a.host, b.host) == 0;
+}
+
+// Finds the entry for `key`. Returns false if there is none (or no database).
+inline bool heat_tuning_lookup(const char* filename, const HeatTuningKey& key, HeatTunedConfig& config) {
+    FILE* file = fopen(filename, "r");
+    if (!file) return false;
+    char line[512];
+    bool found = false;
+    while (fgets(line, sizeof(line), file)) {
+        HeatTuningKey entry_key;
+        HeatTunedConfig entry;
+        if (heat_tuning_parse(line, entry_key, entry) && heat_tuning_key_equal(entry_key, key)) {
+            config = entry;
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// Stores the entry for `key`, replacing any previous one. Returns false on I/O error.
+inline bool heat_tuning_store(const char* filename, const HeatTuningKey& key, const HeatTunedConfig& config) {
+    std::vector<std::string> lines;
+    FILE* file = fopen(filename, "r");
+    if (file) {
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            HeatTuningKey entry_key;
+            HeatTunedConfig entry;
+            if (heat_tuning_parse(line, entry_key, entry) && heat_tuning_key_equal(entry_key, key)) continue;
+            lines.push_back(line);
+        }
+        fclose(file);
+    } else {
+        lines.push_back("# n_global ranks precision host dims_rows dims_cols halo tile_rows tile_cols tile_steps threads mlups\n");
+    }
+
+    std::string tmp_name = std::string(filename) + ".tmp";
+    FILE* out = fopen(tmp_name.c_str(), "w");
+    if (!out) return false;
+    bool ok = true;
+    for (size_t l = 0; ok && l < lines.size(); ++l) ok = fputs(lines[l].c_str(), out) >= 0;
+    ok = ok && fprintf(out, "%d %d %s %s %d %d %d %d %d %d %d %.1f\n", key.n_global, key.ranks, key.precision,
+                       key.host, config.dims[0], config.dims[1], config.halo_depth, config.tiling.tile_rows,
+                       config.tiling.tile_cols, config.tiling.time_steps, config.num_threads, config.mlups) > 0;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmp_name.c_str(), filename) != 0) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif // HEAT_TUNING_H
@@ -0,0 +1,162 @@
+// Micro-benchmark and self-check of the stencil kernel by itself, outside
+// either solver.
+//
+//   stencil_bench [rows] [steps] [--precision P] [--threads N]
+//
+// Runs `steps` explicit steps on a rows x STENCIL_BENCH_WIDTH interior with
+// every row kernel the CPU supports (scalar, SSE2, AVX2, AVX-512) and with the
+// compile-time specialized HeatStencil for that width (heat_grid.h), and
+// checks that each result is bit-identical to the scalar kernel's. The width
+// is fixed at compile time (default 1024):
+//
+//   g++ -O3 -march=native -fopenmp -DSTENCIL_BENCH_WIDTH=4000 stencil_bench.cpp -o stencil_bench.exe
+//
+// Reports the time per step, MLUPS and effective bandwidth (each update
+// reads and writes one element, as in benchmark_suite).
+//
+// Exit codes: 0 if every variant matches, 1 on a mismatch, 2 on usage or
+// allocation errors.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "heat_kernel.h"
+#include "heat_grid.h"
+
+#ifndef STENCIL_BENCH_WIDTH
+#define STENCIL_BENCH_WIDTH 1024 // Interior columns, fixed at compile time
+#endif
+
+#define BENCH_OK 0
+#define BENCH_MISMATCH 1
+#define BENCH_ERROR 2
+
+// Deterministic, non-smooth initial values so that any difference in the
+// evaluation order shows up in the low bits.
+template <typename T>
+void fill_pattern(const HeatGrid<T>& a, const HeatGrid<T>& b) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < a.total_rows(); ++i) {
+        for (int j = 0; j < a.total_cols(); ++j) {
+            unsigned int h = (unsigned int)i * 2654435761u ^ (unsigned int)j * 40503u;
+            a[i][j] = (T)((h % 100003u) / 100003.0);
+            b[i][j] = a[i][j];
+        }
+    }
+}
+
+template <typename T>
+bool grids_identical(const HeatGrid<T>& a, const HeatGrid<T>& b) {
+    for (int i = 0; i < a.total_rows(); ++i) {
+        if (memcmp(a[i], b[i], a.total_cols() * sizeof(T)) != 0) return false;
+    }
+    return true;
+}
+
+// Runs the steps with one specific row kernel (kernel == NULL: the fixed-width
+// HeatStencil) and returns the elapsed seconds; the result ends up in
+// grids[steps % 2].
+template <typename T, typename Acc>
+double time_kernel(StencilRowKernelT<T> kernel, HeatGrid<T> grids[2], int steps, double coef, bool stream) {
+    const int last_row = grids[0].rows();
+    const int last_col = STENCIL_BENCH_WIDTH;
+    fill_pattern(grids[0], grids[1]);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) {
+        T** src = grids[step % 2].data();
+        T** dst = grids[(step + 1) % 2].data();
+        if (!kernel) {
+            HeatStencil<T, Acc, 1, STENCIL_BENCH_WIDTH>::step(grids[step % 2], grids[(step + 1) % 2], coef, stream);
+            continue;
+        }
+        #pragma omp parallel for schedule(static)
+        for (int i = 1; i <= last_row; ++i) {
+            kernel(src[i - 1], src[i], src[i + 1], dst[i], 1, last_col, coef, stream);
+        }
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+template <typename T, typename Acc>
+int run_bench(int rows, int steps, HeatPrecision precision) {
+    const double coef = 0.25; // The explicit stability limit, c dt / ds^2
+    HeatGrid<T> reference[2], grids[2];
+    for (int g = 0; g < 2; ++g) {
+        if (!reference[g].allocate(rows, STENCIL_BENCH_WIDTH, 1) || !grids[g].allocate(rows, STENCIL_BENCH_WIDTH, 1)) {
+            fprintf(stderr, "Failed to allocate memory.\n");
+            return BENCH_ERROR;
+        }
+    }
+    const bool stream = stencil_use_streaming((size_t)reference[0].total_rows() * reference[0].stride() * sizeof(T));
+
+    StencilRowKernelSet<T> set = stencil_row_kernel_set<T, Acc>();
+    struct Variant {
+        const char* name;
+        StencilRowKernelT<T> kernel; // NULL: fixed-width HeatStencil
+        bool supported;
+    } variants[] = {
+        {"scalar", set.scalar, true},
+        {"sse2", set.sse2, false},
+        {"avx2", set.avx2, false},
+        {"avx512", set.avx512, false},
+        {"fixed-width", NULL, true},
+    };
+#ifdef HEAT_KERNEL_X86
+    __builtin_cpu_init();
+    variants[1].supported = set.sse2 && __builtin_cpu_supports("sse2");
+    variants[2].supported = set.avx2 && __builtin_cpu_supports("avx2");
+    variants[3].supported = set.avx512 && __builtin_cpu_supports("avx512f");
+#endif
+
+    printf("Stencil kernel: %d x %d interior, %d steps, precision %s, %d threads%s\n", rows, STENCIL_BENCH_WIDTH,
+           steps, heat_precision_name(precision), heat_num_threads(), stream ? ", streaming stores" : "");
+    printf("%-12s %12s %10s %10s  %s\n", "variant", "s/step", "MLUPS", "GB/s", "check");
+    double points = (double)rows * STENCIL_BENCH_WIDTH * steps;
+    int status = BENCH_OK;
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        if (!variants[v].supported) continue;
+        bool is_reference = v == 0;
+        HeatGrid<T>* target = is_reference ? reference : grids;
+        double seconds = time_kernel<T, Acc>(variants[v].kernel, target, steps, coef, stream);
+        bool identical = is_reference || grids_identical(reference[steps % 2], grids[steps % 2]);
+        double mlups = points / seconds / 1e6;
+        printf("%-12s %12.3e %10.1f %10.2f  %s\n", variants[v].name, seconds / steps, mlups,
+               mlups * 2.0 * sizeof(T) / 1e3, is_reference ? "reference" : identical ? "identical" : "MISMATCH");
+        if (!identical) status = BENCH_MISMATCH;
+    }
+    return status;
+}
+
+int main(int argc, char* argv[]) {
+    int rows = 1024;
+    int steps = 100;
+    HeatPrecision precision = HEAT_PRECISION_DOUBLE;
+    int positional = 0;
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--precision") == 0 && a + 1 < argc) {
+            if (!parse_heat_precision(argv[++a], precision)) {
+                fprintf(stderr, "Unknown precision %s (use double, float or mixed).\n", argv[a]);
+                return BENCH_ERROR;
+            }
+        } else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            heat_set_num_threads(atoi(argv[++a]));
+        } else if (argv[a][0] != '-' && positional < 2) {
+            (positional++ == 0 ? rows : steps) = atoi(argv[a]);
+        } else {
+            fprintf(stderr, "Usage: %s [rows] [steps] [--precision P] [--threads N]\n", argv[0]);
+            return BENCH_ERROR;
+        }
+    }
+    if (rows < 1 || steps < 1) {
+        fprintf(stderr, "rows and steps must be positive.\n");
+        return BENCH_ERROR;
+    }
+
+    switch (precision) {
+        case HEAT_PRECISION_FLOAT: return run_bench<float, float>(rows, steps, precision);
+        case HEAT_PRECISION_MIXED: return run_bench<float, double>(rows, steps, precision);
+        default: return run_bench<double, double>(rows, steps, precision);
+    }
+}